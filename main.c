@@ -7,64 +7,949 @@ Language      : C Programming
 Features:
     - User registration & login (password hidden while typing)
     - Admin authentication with special key
-    - Admin menu: Add Car, List Cars, Delete Car
-    - Customer menu: Rent Car, Return Car, List Rentals
+    - Salted scrypt password hashes, verified on a worker pool
+    - Admin menu: Add Car, List Cars, Delete Car, List Rentals,
+      Revenue Report, Statistics, bulk fleet import/export (CSV),
+      Find Customers
+    - Customer menu: Rent Car, Return Car, My Rentals, Search Cars,
+      Top Picks, Find Cars by Name
     - File handling with robust fscanf/fprintf
+    - Append-only journal: each change is logged, the data is
+      rewritten only at checkpoints; a writer thread group-commits the
+      records with one fdatasync per batch (--durability sync|async)
+    - Binary snapshot (data.bin) mapped straight into memory at startup;
+      the .txt files are kept as an import/export format, imported by a
+      parallel in-place parser with line-numbered errors
+    - Batch mode (--batch FILE) replays a command script without the
+      terminal and reports per-operation throughput
+    - Synthetic data generator (--generate N) and benchmark suite
+      (--bench N [OUT]) with ns/op, p50/p99 and peak RSS
+    - Server mode (--serve PATH) for many concurrent sessions on a
+      Unix socket, served by a worker pool
     - Rent Car prints a bill-style receipt
+    - Car search filters column arrays of price/year/brand/status with
+      vector compares
+    - Cars belong to branches; searches are sharded by branch, each shard
+      with its own columns and lock, and fleet-wide scans fan out over them
+    - Top Picks: the k cheapest, newest or most rented available cars,
+      read off the sorted indexes or kept in a bounded heap (O(n log k))
+    - Rentals book a car for a date range and may start in the future;
+      each car keeps its bookings sorted for O(log n) conflict checks
+    - Revenue Report: revenue and utilization per car, brand and
+      customer, kept as running totals instead of rescanning rentals
+    - Returned rentals are archived in compressed, append-only history
+      files; only open rentals are loaded at startup
+    - Latency histograms (p50/p90/p99/p99.9) and success/failure counts
+      per operation, shown under Statistics and written to stats.txt
+    - Car and rental listings are paged (n/p/q), 20 rows per screen
+    - Brand, model and customer names are interned in dictionaries;
+      records hold small ids and sort by the names' ranks; a trie per
+      dictionary finds names by prefix and with small typos
+    - Instances in one directory share a consistent state through the
+      journal and a shared-memory lock (see Shared State)
 ===============================================================================
 */
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <stddef.h>
 #include <string.h>
+#include <ctype.h>
 #include <unistd.h>
 #include <termios.h>
 #include <stdio_ext.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/random.h>
+#include <signal.h>
+#include <pthread.h>
+#include <time.h>
 
 // --------------------------- Definitions ---------------------------
-#define MAX_USER 100
 #define CREDENTIAL_LENGTH 30
-#define MAX_CARS 100
-#define MAX_RENTALS 100
+#define NAME_LENGTH 30          // brands and models
+#define CUSTOMER_NAME_LENGTH 50
+#define PASSWORD_HASH_LENGTH 128
 #define ADMIN_KEY "admin123"
+#define JOURNAL_FILE "journal.log"
+#define JOURNAL_CHECKPOINT_EVERY 1000
+
+// Instances started in the same directory share one POSIX shared memory
+// object, named after the directory; see sharedOpen().
+#define SHARED_NAME_FORMAT "/car_rental-%08x"
+#define SHARED_MAGIC 0x34535243 // "CRS4"; change it with SharedState
+#define SHARED_CLOSED 0x58535243 // "CRSX": the last instance has left
+#define SHARED_MAX_INSTANCES 64
+
+#define SNAPSHOT_FILE "data.bin"
+#define SNAPSHOT_TMP_FILE "data.bin.tmp"
+#define SNAPSHOT_MAGIC 0x53524143 // "CARS"
+#define HISTORY_FILE_FORMAT "history-%06d.bin"
+#define HISTORY_MAGIC 0x54534948 // "HIST"
+#define SNAPSHOT_VERSION 1
+#define SNAPSHOT_ALIGN 64
+
+// Arena blocks are carved into table chunks; a chunk never moves once
+// allocated, so a record's address stays valid for the life of the process.
+#define ARENA_BLOCK_SIZE (1 << 20)
+#define ARENA_ALIGN 16
+#define TABLE_CHUNK_SHIFT 10
+#define TABLE_CHUNK_SIZE (1 << TABLE_CHUNK_SHIFT)
+#define TABLE_CHUNK_MASK (TABLE_CHUNK_SIZE - 1)
+
+// Sorted car indexes are skip lists; each level keeps about 1/4 of the
+// nodes of the level below it.
+#define SKIP_MAX_LEVEL 16
+
+// Listings are rendered a page at a time into one buffer.
+#define LIST_PAGE_SIZE 20
+
+// The revenue report ranks this many cars and customers.
+#define REPORT_TOP 10
+
+// Closed rentals are archived in segments of at most this many records;
+// a packed record never takes more than HISTORY_RECORD_MAX bytes.
+#define HISTORY_SEGMENT_RECORDS 65536
+#define HISTORY_RECORD_MAX 96
+
+// Latency histograms split every power of two of nanoseconds into
+// 2^METRIC_SUB_BITS buckets; STATS_FILE is rewritten every STATS_INTERVAL
+// seconds.
+#define METRIC_SUB_BITS 4
+#define METRIC_BUCKETS ((64 - METRIC_SUB_BITS + 1) << METRIC_SUB_BITS)
+#define STATS_FILE "stats.txt"
+#define STATS_TMP_FILE "stats.txt.tmp"
+#define STATS_INTERVAL 60
+
+// Searches filter the car columns this many slots at a time, SEARCH_LANES
+// per vector compare (16-byte vectors: SSE2 on x86-64, NEON on ARM).
+#define SEARCH_BLOCK 1024
+#define SEARCH_LANES 4
+
+// Every car belongs to a branch; data from before branches is in
+// BRANCH_DEFAULT. Scans over many cars fan out over the branch shards on
+// up to SHARD_SCAN_THREADS threads once they cover SHARD_PARALLEL_MIN cars.
+#define BRANCH_DEFAULT "Main"
+#define SHARD_SCAN_THREADS 8
+#define SHARD_PARALLEL_MIN 65536
+
+// Name searches match prefixes and forgive one typo from NAME_TYPO_LENGTH
+// characters on, two from twice that; at most FIND_NAMES names are matched.
+#define NAME_TYPOS_MAX 2
+#define NAME_TYPO_LENGTH 4
+#define FIND_NAMES 20
+
+#define COMMAND_LINE_LENGTH 512
+#define COMMAND_MAX_FIELDS 8
+
+// Text files are parsed in chunks of at least TEXT_PARSE_CHUNK bytes, one
+// thread each; only the first TEXT_ERRORS_SHOWN bad lines are reported.
+#define TEXT_PARSE_CHUNK (1 << 20)
+#define TEXT_PARSE_THREADS 16
+#define TEXT_MAX_FIELDS 8
+#define TEXT_ERRORS_SHOWN 10
+
+// Fleet CSV files (bulk import/export of cars) start with this line,
+// followed by FLEET_CSV_BRANCH if they have the optional branch column; an
+// export is written out every FLEET_EXPORT_BLOCK bytes.
+#define FLEET_CSV_HEADER "brand,model,year,price"
+#define FLEET_CSV_BRANCH ",branch"
+#define FLEET_EXPORT_BLOCK (1 << 16)
+
+#define SERVER_DEFAULT_WORKERS 8
+#define SERVER_QUEUE_LENGTH 256
+#define SERVER_BACKLOG 128
+#define CAR_LOCK_STRIPES 256
+
+#define BENCH_DEFAULT_OUTPUT "bench_results.csv"
+#define BENCH_LOGINS 10000
+#define BENCH_RENT_CYCLES 2000
+#define BENCH_SEARCHES 1000
+#define BENCH_BRANCHES 8
+#define BENCH_TOP_K 10
+
+// Password hashing: scrypt with N = 2^log2N, r and p. The default costs
+// 16 MiB and tens of milliseconds per hash; --kdf-cost changes log2N for
+// new hashes. Generated benchmark data uses a cheap setting unless told
+// otherwise, so the other timings stay readable.
+#define KDF_PREFIX "$scrypt$"
+#define KDF_DEFAULT_LOG2N 14
+#define KDF_MAX_LOG2N 20
+#define KDF_R 8
+#define KDF_P 1
+#define KDF_SALT_LENGTH 16
+#define KDF_HASH_LENGTH 32
+#define BENCH_KDF_LOG2N 8
 
 // --------------------------- Structures ---------------------------
+// password holds a KDF_PREFIX hash, never the password itself.
 typedef struct
 {
     char username[CREDENTIAL_LENGTH];
-    char password[CREDENTIAL_LENGTH];
+    char password[PASSWORD_HASH_LENGTH];
     int isAdmin;
 } User;
 
+// A car slot whose id is 0 is a tombstone left by deleteCar(); it sits on
+// the free list until addCar() reuses it. brand, model and branch are ids
+// in brandDict, modelDict and branchDict.
 typedef struct
 {
     int id;
-    char brand[30];
-    char model[30];
+    int brand;
+    int model;
+    int branch;
     int year;
     float pricePerDay;
     int isAvailable;
 } Car;
 
+// A rental books its car for the days [startDay, endDay), counted in days
+// since 1970-01-01; it may start in the future. isReturned is -1 only
+// while loading data from before returns were recorded, and both days are
+// 0 for closed rentals from before dates were; resolveRentalStatus()
+// settles them. customer is an id in customerDict.
 typedef struct
 {
     int rentalId;
-    char customerName[50];
+    int customer;
     int carId;
     int days;
     float totalCost;
+    int isReturned;
+    int startDay;
+    int endDay;
 } Rental;
 
+typedef struct ArenaBlock
+{
+    struct ArenaBlock *next;
+    size_t used;
+    size_t size;
+    unsigned char data[];
+} ArenaBlock;
+
+typedef struct
+{
+    ArenaBlock *head;
+} Arena;
+
+// Growable table of fixed-size records. Records live in chunks of
+// TABLE_CHUNK_SIZE taken from an arena; only the chunk directory is ever
+// reallocated, so the index of a record is a stable handle.
+typedef struct
+{
+    size_t elemSize;
+    int count;
+    int chunkCount;
+    int chunkCap;
+    void **chunks;
+    Arena *arena;
+} Table;
+
+typedef struct
+{
+    int *items;
+    int count;
+    int cap;
+} IntVec;
+
+// A node of a dictionary's name trie. Names are folded to lower case;
+// children hang off child as a sibling list sorted by c, so a depth-first
+// walk meets the names in alphabetical order. Node 0 is the root, so 0 in
+// child or sibling means none.
+typedef struct
+{
+    int child;
+    int sibling;
+    int name; // id + 1 of the first name ending here, 0 if none
+    unsigned char c;
+} TrieNode;
+
+// Interned strings: every distinct name is stored once in names (records
+// of names.elemSize bytes) and referred to by its id, handed out in the
+// order names are first seen. order lists the first ranked ids by name and
+// rank is its inverse, so comparing two ranks compares the names. Ranks are
+// only recomputed when the hash grows, so adding a name costs no more than
+// a hash insert; names added since compare by text (dictCompare()). trie
+// holds the names for prefix and typo-tolerant search (see dictSearch()).
+typedef struct
+{
+    Table names;
+    int *slots; // open addressing: id + 1, 0 if empty
+    int slotCap;
+    IntVec order;
+    IntVec rank;
+    int ranked; // ids below this have a rank
+    Table trie;
+    IntVec sameKey; // id -> id + 1 of the next name that folds the same
+} Dictionary;
+
+// State of one dictSearch() walk: the matches found so far, by number of
+// typos, each list in alphabetical order and at most limit long.
+typedef struct
+{
+    const Dictionary *dict;
+    unsigned char query[CUSTOMER_NAME_LENGTH];
+    int length;
+    int maxTypos;
+    int limit;
+    IntVec found[NAME_TYPOS_MAX + 1];
+} NameSearch;
+
+// span counts the nodes a link skips over, so a position in the list can be
+// reached in O(log n) without walking the bottom level.
+typedef struct
+{
+    struct SkipNode *node;
+    int span;
+} SkipLink;
+
+typedef struct SkipNode
+{
+    int slot;
+    int level;
+    SkipLink next[];
+} SkipNode;
+
+typedef int (*CarCompare)(const Car *a, const Car *b);
+
+// Car slots ordered by cmp (ties broken by id, so every car has exactly
+// one position). Removed nodes go on a per-level free list for reuse.
+typedef struct
+{
+    CarCompare cmp;
+    int level;
+    int length;
+    SkipNode *head;
+    SkipNode *freeNodes[SKIP_MAX_LEVEL + 1];
+} SkipList;
+
+// Column copy of the fields car searches filter on, one row per car of a
+// shard. Every column is 32 bits wide so one predicate loop handles the
+// same number of cars per vector lane. status is CAR_STATUS_*; brand is an
+// id from brandTable (-1 for a free row); slot is the car's slot.
+typedef struct
+{
+    float *price;
+    int *year;
+    int *brand;
+    int *status;
+    int *slot;
+    int count;
+    int cap;
+} CarColumns;
+
+enum
+{
+    CAR_STATUS_DELETED,
+    CAR_STATUS_RENTED,
+    CAR_STATUS_AVAILABLE
+};
+
+typedef float SearchFloats __attribute__((vector_size(SEARCH_LANES * sizeof(float))));
+typedef int SearchInts __attribute__((vector_size(SEARCH_LANES * sizeof(int))));
+
+// A car search; brand "" matches every brand, maxPrice 0 means no limit,
+// and a NULL or "" branch searches every branch.
+typedef struct
+{
+    const char *brand;
+    float minPrice;
+    float maxPrice;
+    int minYear;
+    int availableOnly;
+    const char *branch;
+} CarQuery;
+
+// A car's open rentals as [startDay, endDay) intervals. They never overlap,
+// so sorted by start they are sorted by end too, and a binary search finds
+// the only booking that can conflict with a new one.
+typedef struct
+{
+    int startDay;
+    int endDay;
+    int rentalSlot;
+} Booking;
+
+typedef struct
+{
+    Booking *items;
+    int count;
+    int cap;
+} BookingVec;
+
+// Running totals of one car or customer.
+typedef struct
+{
+    double revenue;
+    int rentals;
+} RentalTotals;
+
+// An entry of brandTable (or branchTable): the running totals of the
+// brand (branch) with the same id in brandDict (branchDict). cars and
+// rented count its live cars and are recounted at startup.
+typedef struct
+{
+    int cars;
+    int rented;
+    int rentals;
+    double revenue;
+} BrandStats;
+
+// The cars of one branch. Each shard has its own search columns, one row
+// per car (rows of deleted cars are reused, like car slots), and its own
+// lock over their status and its cars' bookings, so a scan of one branch
+// never waits on the shard lock of a rental at another. Only scans are
+// sharded: changes still go through indexLock and the one journal.
+typedef struct
+{
+    pthread_mutex_t lock;
+    CarColumns columns;
+    IntVec freeRows;
+} Shard;
+
+// Kinds of top-K query over the available cars.
+enum
+{
+    TOP_CHEAPEST,
+    TOP_NEWEST,
+    TOP_MOST_RENTED
+};
+
+// A car ranked by a top-K query: higher key first, then higher tie.
+typedef struct
+{
+    int slot;
+    double key;
+    int tie;
+} TopEntry;
+
+// The best limit entries seen so far, as a min-heap: items[0] is the
+// worst kept, so a car that does not beat it costs one compare.
+typedef struct
+{
+    TopEntry *items;
+    int count;
+    int limit;
+} TopHeap;
+
+// One thread's part of a scan of the shards: a search (query set), a
+// top-K query (heap.limit set) or a free-car check over [startDay,
+// endDay). Each shard scanned is split into parts of whole SEARCH_BLOCKs
+// and this thread takes part number part.
+typedef struct
+{
+    const CarQuery *query;
+    int brandId;
+    int startDay;
+    int endDay;
+    int branch; // -1: every branch
+    int part;
+    int parts;
+    IntVec hits;
+    int topKind;
+    TopHeap heap;
+} ShardScan;
+
+// Totals over the whole fleet; the only record of SECTION_FLEET_STATS.
+typedef struct
+{
+    double revenue;
+    long long rentals;
+    int cars;
+    int rented;
+} FleetStats;
+
+// A history segment file is this header followed by size bytes of its
+// records, oldest first, each packed by historyEncode().
+typedef struct
+{
+    unsigned int magic;
+    int records;
+    int size;
+} HistoryHeader;
+
+// How many of a customer's rentals one history segment holds. Each
+// customer's entries are chained newest segment first through next (the
+// entry's index + 1, 0 after the oldest).
+typedef struct
+{
+    int customer;
+    int segment;
+    int count;
+    int next;
+} HistoryRef;
+
+// Counters and latency histogram of one kind of operation. Values below
+// 2^METRIC_SUB_BITS ns get a bucket each; above that each power of two is
+// split into 2^METRIC_SUB_BITS buckets, so a recorded latency is known to
+// within 1/16 (HDR histogram style) at any magnitude. Updated with atomic
+// adds from any thread and read without locking.
+typedef struct
+{
+    unsigned long long ok;
+    unsigned long long failed;
+    unsigned long long totalNs;
+    unsigned long long maxNs;
+    unsigned long long buckets[METRIC_BUCKETS];
+} Metric;
+
+enum
+{
+    METRIC_LOAD,
+    METRIC_SAVE,
+    METRIC_REGISTER,
+    METRIC_LOGIN,
+    METRIC_ADD_CAR,
+    METRIC_DELETE_CAR,
+    METRIC_RENT,
+    METRIC_RETURN,
+    METRIC_SEARCH,
+    METRIC_AVAILABILITY,
+    METRIC_TOP_CARS,
+    METRIC_FIND_NAME,
+    METRIC_LIST_CARS,
+    METRIC_IMPORT_CARS,
+    METRIC_EXPORT_CARS,
+    METRIC_JOURNAL_SYNC,
+    METRIC_COUNT
+};
+
+// Reusable output buffer: a screen is formatted here and written at once.
+typedef struct
+{
+    char *data;
+    size_t len;
+    size_t cap;
+} OutBuf;
+
+// Snapshot layout: this header, then one section per entry below, each
+// starting at a SNAPSHOT_ALIGN boundary. The element sizes are stored so a
+// build with a different record layout refuses the file instead of
+// misreading it.
+enum
+{
+    SECTION_USERS,
+    SECTION_CARS,
+    SECTION_RENTALS,
+    SECTION_CAR_IDS,
+    SECTION_RENTAL_IDS,
+    SECTION_FREE_CARS,
+    SECTION_CAR_STATS,
+    SECTION_CUSTOMER_STATS,
+    SECTION_BRAND_STATS,
+    SECTION_FLEET_STATS,
+    SECTION_HISTORY,
+    SECTION_BRAND_NAMES,
+    SECTION_MODEL_NAMES,
+    SECTION_CUSTOMER_NAMES,
+    SECTION_JOURNAL, // how much of the journal the snapshot holds
+    SECTION_BRANCH_NAMES,
+    SECTION_BRANCH_STATS,
+    SECTION_HISTORY_REFS,
+    SECTION_COUNT
+};
+
+typedef struct
+{
+    long long offset;
+    long long count;
+    long long elemSize;
+} SnapshotSection;
+
+typedef struct
+{
+    unsigned int magic;
+    unsigned int version;
+    int nextCarId;
+    int nextRentalId;
+    SnapshotSection sections[SECTION_COUNT];
+} SnapshotHeader;
+
+enum
+{
+    COMMAND_REGISTER,
+    COMMAND_LOGIN,
+    COMMAND_LOGOUT,
+    COMMAND_ADD_CAR,
+    COMMAND_DELETE_CAR,
+    COMMAND_RENT_CAR,
+    COMMAND_RETURN_CAR,
+    COMMAND_IMPORT_CARS,
+    COMMAND_EXPORT_CARS,
+    COMMAND_TOP_CARS,
+    COMMAND_COUNT
+};
+
+typedef struct
+{
+    const char *name;
+    int minFields;
+} Command;
+
+// Per-connection (or per-batch) state: the logged in user, or -1. Its
+// role and name are copied at login, so commands never read userTable
+// without the lock.
+typedef struct
+{
+    int user;
+    int isAdmin;
+    char username[CREDENTIAL_LENGTH];
+} Session;
+
+typedef struct
+{
+    unsigned int state[8];
+    unsigned long long length;
+    unsigned char buffer[64];
+    size_t fill;
+} Sha256;
+
+// One derivation for the KDF pool. A hash job fills hash from password; a
+// verify job checks password against hash and sets result to 1 on a match.
+typedef struct KdfJob
+{
+    int verify;
+    char password[PASSWORD_HASH_LENGTH];
+    char hash[PASSWORD_HASH_LENGTH];
+    int result;
+    int done;
+    struct KdfJob *next;
+} KdfJob;
+
+// Accepted connections waiting for a server worker.
+typedef struct
+{
+    int fds[SERVER_QUEUE_LENGTH];
+    int head;
+    int count;
+    pthread_mutex_t lock;
+    pthread_cond_t notEmpty;
+    pthread_cond_t notFull;
+} ConnQueue;
+
+enum
+{
+    TEXT_USERS,
+    TEXT_CARS,
+    TEXT_RENTALS,
+    TEXT_FLEET
+};
+
+// One parsed line of a text file. name and text point into the mapped
+// file: username and password, brand and model, or the rental's customer;
+// branch is a car's branch ("" if the line has none). They are copied or
+// interned once every chunk has been parsed.
+typedef struct
+{
+    const char *name;
+    const char *text;
+    const char *branch;
+    union
+    {
+        int isAdmin;
+        Car car;
+        Rental rental;
+    };
+} TextRecord;
+
+// A run of whole lines of a mapped text file, parsed by one thread. Line
+// numbers are counted from the chunk's first line until they are reported.
+typedef struct
+{
+    int kind;
+    char *begin;
+    char *end;
+    TextRecord *records;
+    int count;
+    int cap;
+    int lines;
+    int errors;
+    int errorLines[TEXT_ERRORS_SHOWN];
+    const char *errorText[TEXT_ERRORS_SHOWN];
+    char tail[COMMAND_LINE_LENGTH]; // a last line with no newline
+} TextChunk;
+
+// What every instance working in one directory shares. lock serializes
+// changes between processes (and survives a process dying while holding
+// it); journalSize is how many bytes of JOURNAL_FILE have been claimed
+// for records; pids lists the running instances (0 for a free entry),
+// starts when each of them started, so that a new process given a pid
+// that is still listed is not taken for the old one, and unwritten how
+// many of the bytes each has claimed its writer has yet to write.
+// instances counts the listed pids, and lockless the changes each is
+// making without the lock while it is on its own.
+typedef struct
+{
+    unsigned int magic;
+    pthread_mutex_t lock;
+    long long journalSize;
+    int instances;
+    pid_t pids[SHARED_MAX_INSTANCES];
+    unsigned long long starts[SHARED_MAX_INSTANCES];
+    long long unwritten[SHARED_MAX_INSTANCES];
+    int lockless[SHARED_MAX_INSTANCES];
+} SharedState;
+
+// Queued journal text bound for one place in the file.
+typedef struct
+{
+    long long offset;
+    size_t len;
+} JournalRun;
+
 // --------------------------- Global Variables ---------------------------
-User users[MAX_USER];
-Car cars[MAX_CARS];
-Rental rentals[MAX_RENTALS];
+// Locking for concurrent sessions; see the Operations section.
+pthread_rwlock_t storeLock = PTHREAD_RWLOCK_INITIALIZER;
+SharedState *shared = NULL; // NULL if this instance runs on its own
+int sharedSlot = -1;        // this instance's entry in shared->pids
+__thread int sharedHeld = 0; // this thread's change holds the shared lock
+char sharedName[64];
+pthread_mutex_t indexLock = PTHREAD_MUTEX_INITIALIZER;
+pthread_mutex_t carLocks[CAR_LOCK_STRIPES] = {[0 ... CAR_LOCK_STRIPES - 1] = PTHREAD_MUTEX_INITIALIZER};
+ConnQueue connQueue = {.lock = PTHREAD_MUTEX_INITIALIZER, .notEmpty = PTHREAD_COND_INITIALIZER, .notFull = PTHREAD_COND_INITIALIZER};
+
+// Password hashing pool: jobs wait in a FIFO for one of kdfWorkers threads
+// (0 = one per CPU), started on first use.
+int kdfLog2N = KDF_DEFAULT_LOG2N;
+int kdfWorkers = 0;
+pthread_mutex_t kdfLock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t kdfQueued = PTHREAD_COND_INITIALIZER;
+pthread_cond_t kdfDone = PTHREAD_COND_INITIALIZER;
+KdfJob *kdfQueue = NULL;
+KdfJob *kdfQueueTail = NULL;
+
+// Open-addressing hash of username -> user index. Slots hold index + 1 so
+// that 0 marks an empty slot; users are never removed, so no tombstones.
+int *userHashSlots = NULL;
+int userHashCap = 0;
+
+// IDs are handed out from monotonic counters that are persisted with the
+// data, so an ID is never reused even after its record is deleted.
+int nextCarId = 1;
+int nextRentalId = 1;
+
+// id -> slot maps (entries hold slot + 1, 0 = unknown id) and the list of
+// tombstoned car slots waiting to be reused.
+IntVec carSlotById = {0};
+IntVec rentalSlotById = {0};
+IntVec freeCarSlots = {0};
 
-int user_count = 0;
-int carCount = 0;
-int rentalCount = 0;
+// Secondary indexes for listCars().
+int compareId(const Car *a, const Car *b);
+int compareBrand(const Car *a, const Car *b);
+int compareModel(const Car *a, const Car *b);
+int compareYear(const Car *a, const Car *b);
+int comparePrice(const Car *a, const Car *b);
+int compareStatus(const Car *a, const Car *b);
+SkipList carsById = {.cmp = compareId};
+SkipList carsByBrand = {.cmp = compareBrand};
+SkipList carsByModel = {.cmp = compareModel};
+SkipList carsByYear = {.cmp = compareYear};
+SkipList carsByPrice = {.cmp = comparePrice};
+SkipList carsByStatus = {.cmp = compareStatus};
+SkipList *carIndexes[] = {&carsById, &carsByBrand, &carsByModel, &carsByYear, &carsByPrice, &carsByStatus};
+
+// Live cars by brand and model: open addressing on the pair of dictionary
+// ids, each entry a car slot + 1 (0 is empty). Kept with the indexes.
+int *carNameSlots = NULL;
+int carNameCap = 0;
+int carNameCount = 0;
+#define CAR_INDEX_COUNT (int)(sizeof(carIndexes) / sizeof(carIndexes[0]))
+
+// Journal writer: journalAppend() claims the record's place in the file
+// and queues it in journalPending (journalRuns says where each stretch
+// goes); the writer thread moves everything queued to the file at once
+// with a single fdatasync (group commit). journalQueued and journalSynced
+// count records; in JOURNAL_SYNC mode an operation returns only once its
+// own records are synced, in JOURNAL_ASYNC once they are queued. Every
+// JOURNAL_CHECKPOINT_EVERY records a checkpoint falls due, and the next
+// journalCommit() takes it once the operation has let go of its locks.
+enum
+{
+    JOURNAL_ASYNC,
+    JOURNAL_SYNC
+};
+int journalMode = JOURNAL_ASYNC;
+int journalFd = -1;
+int journalOps = 0;
+long long journalOffset = 0; // bytes of the journal applied to the tables
+OutBuf journalPending = {0};
+JournalRun *journalRuns = NULL;
+int journalRunCount = 0;
+int journalRunCap = 0;
+int journalCheckpointDue = 0;
+long long journalQueued = 0;
+long long journalSynced = 0;
+__thread long long journalLast = 0; // this thread's newest record
+pthread_mutex_t journalLock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t journalWork = PTHREAD_COND_INITIALIZER;
+pthread_cond_t journalDurable = PTHREAD_COND_INITIALIZER;
+pthread_t journalThread;
+int journalStarted = 0;
+
+// One histogram per METRIC_*, for the life of the process.
+Metric metrics[METRIC_COUNT];
+const char *metricNames[METRIC_COUNT] = {
+    [METRIC_LOAD] = "load",
+    [METRIC_SAVE] = "save",
+    [METRIC_REGISTER] = "register",
+    [METRIC_LOGIN] = "login",
+    [METRIC_ADD_CAR] = "add_car",
+    [METRIC_DELETE_CAR] = "delete_car",
+    [METRIC_RENT] = "rent",
+    [METRIC_RETURN] = "return",
+    [METRIC_SEARCH] = "search",
+    [METRIC_AVAILABILITY] = "availability",
+    [METRIC_TOP_CARS] = "top_cars",
+    [METRIC_FIND_NAME] = "find_name",
+    [METRIC_LIST_CARS] = "list_cars",
+    [METRIC_IMPORT_CARS] = "import_cars",
+    [METRIC_EXPORT_CARS] = "export_cars",
+    [METRIC_JOURNAL_SYNC] = "journal_sync",
+};
+
+// Listing screens are formatted here; the buffer is kept between pages.
+OutBuf listBuf = {0};
+
+// The snapshot currently mapped by loadSnapshot(), released on the next load.
+char *snapshotBase = NULL;
+size_t snapshotSize = 0;
+
+Arena storeArena;
+Table userTable = {sizeof(User), 0, 0, 0, NULL, &storeArena};
+Table carTable = {sizeof(Car), 0, 0, 0, NULL, &storeArena};
+Table rentalTable = {sizeof(Rental), 0, 0, 0, NULL, &storeArena};
+
+// Per-customer rental index: entry i holds the rental slots of user i, in
+// the order they were made. Rebuilt at startup, extended by doRentCar().
+Table customerRentalTable = {sizeof(IntVec), 0, 0, 0, NULL, &storeArena};
+
+// Bookings of each car, indexed by car slot. Entries are created with the
+// slot (under the write lock), so rent and return only ever look them up.
+Table carBookingTable = {sizeof(BookingVec), 0, 0, 0, NULL, &storeArena};
+int availabilityDay; // the day isAvailable was last settled for; see availabilityRefresh()
+
+// Brand, model and customer names, interned. Names are only added under
+// the write lock (or while loading), so readers need no more than the
+// read lock; every registered user has a customer id.
+Dictionary brandDict = {{NAME_LENGTH, 0, 0, 0, NULL, &storeArena}, .trie = {sizeof(TrieNode), 0, 0, 0, NULL, &storeArena}};
+Dictionary modelDict = {{NAME_LENGTH, 0, 0, 0, NULL, &storeArena}, .trie = {sizeof(TrieNode), 0, 0, 0, NULL, &storeArena}};
+Dictionary customerDict = {{CUSTOMER_NAME_LENGTH, 0, 0, 0, NULL, &storeArena}, .trie = {sizeof(TrieNode), 0, 0, 0, NULL, &storeArena}};
+Dictionary branchDict = {{NAME_LENGTH, 0, 0, 0, NULL, &storeArena}, .trie = {sizeof(TrieNode), 0, 0, 0, NULL, &storeArena}};
+const Dictionary *dictSorting; // the one compareDictIds() is sorting
+
+// Each brand's and each branch's totals, by id. Shards are indexed by
+// branch id too and carRows gives each car slot's row in its shard; both
+// are rebuilt at startup.
+Table brandTable = {sizeof(BrandStats), 0, 0, 0, NULL, &storeArena};
+Table branchTable = {sizeof(BrandStats), 0, 0, 0, NULL, &storeArena};
+Table shardTable = {sizeof(Shard), 0, 0, 0, NULL, &storeArena};
+IntVec carRows = {0};
+
+// Revenue totals, updated as rentals are made: per car slot, per user
+// index, per brand and branch (in brandTable and branchTable) and for the
+// fleet. Rent and return change them under indexLock.
+Table carStatsTable = {sizeof(RentalTotals), 0, 0, 0, NULL, &storeArena};
+Table customerStatsTable = {sizeof(RentalTotals), 0, 0, 0, NULL, &storeArena};
+FleetStats fleetStats = {0};
+
+// Returned rentals are moved out of rentalTable into history segment files
+// HISTORY_FILE_FORMAT 0, 1, ... The snapshot keeps the record count of
+// each committed segment, and historyRefTable, which says which segments
+// hold a customer's rentals; the last segment read back is cached.
+IntVec historyCounts = {0};
+int historyTotal = 0;
+Table historyRefTable = {sizeof(HistoryRef), 0, 0, 0, NULL, &storeArena};
+IntVec historyRefHead = {0}; // customer id -> index + 1 of its newest entry
+Rental *historyCache = NULL;
+int historyCacheSegment = -1;
 
 // --------------------------- Function Prototypes ---------------------------
+// Storage
+void *xrealloc(void *p, size_t size);
+void *arenaAlloc(Arena *arena, size_t size);
+void *tableAppend(Table *t);
+void tableClear(Table *t);
+void tableAttach(Table *t, char *base, int count);
+static inline void *tableAt(const Table *t, int index)
+{
+    return (char *)t->chunks[index >> TABLE_CHUNK_SHIFT] + (size_t)(index & TABLE_CHUNK_MASK) * t->elemSize;
+}
+static inline User *userAt(int index) { return (User *)tableAt(&userTable, index); }
+static inline Car *carAt(int index) { return (Car *)tableAt(&carTable, index); }
+static inline Rental *rentalAt(int index) { return (Rental *)tableAt(&rentalTable, index); }
+int dictFind(const Dictionary *d, const char *name);
+int dictIntern(Dictionary *d, const char *name);
+void dictClear(Dictionary *d);
+void dictRebuild(Dictionary *d);
+int dictCompare(const Dictionary *d, int a, int b);
+int compareDictIds(const void *a, const void *b);
+static inline const char *dictName(const Dictionary *d, int id) { return (const char *)tableAt(&d->names, id); }
+static inline const char *carBrand(const Car *c) { return dictName(&brandDict, c->brand); }
+static inline const char *carModel(const Car *c) { return dictName(&modelDict, c->model); }
+static inline const char *carBranch(const Car *c) { return dictName(&branchDict, c->branch); }
+static inline const char *rentalCustomer(const Rental *r) { return dictName(&customerDict, r->customer); }
+void intVecPush(IntVec *v, int value);
+void intVecResize(IntVec *v, int count);
+void idMapSet(IntVec *map, int id, int slot);
+int idMapGet(const IntVec *map, int id);
+
+// Operations (no terminal I/O; shared by the menus, batch and server mode)
+pthread_mutex_t *carLock(int carId);
+int validName(const char *name, size_t size);
+int doRegister(const char *username, const char *password, int isAdmin);
+int doLogin(const char *username, const char *password);
+int doAddCar(const char *brand, const char *model, int year, float pricePerDay, const char *branch);
+int doDeleteCar(int id);
+int doRentCar(const char *username, int carId, int startDay, int days);
+int doReturnCar(const char *username, int rentalId);
+int doSearchCars(const CarQuery *q, IntVec *hits);
+int doFreeCars(int startDay, int endDay, const char *branch, IntVec *hits);
+int doTopCars(int kind, int k, const char *branch, IntVec *hits);
+int doFindCars(const char *text, IntVec *hits);
+int doFindCustomers(const char *text, IntVec *users);
+int doImportCars(const char *path, int *duplicates);
+int doExportCars(const char *path);
+
+// Commands, batch and server mode
+double nowSeconds();
+int splitFields(char *line, char **fields, int maxFields);
+int executeCommand(Session *session, char *line, int *result);
+int runBatch(const char *path);
+void connQueuePush(int fd);
+int connQueuePop();
+void serveSession(int fd);
+void *serverWorker(void *arg);
+int runServer(const char *path, int workers);
+
+// Benchmarks
+unsigned int benchRandom();
+void generateData(int scale);
+int runBenchmarks(int scale, const char *outPath);
+
+// Password hashing
+void sha256Init(Sha256 *ctx);
+void sha256Update(Sha256 *ctx, const void *data, size_t len);
+void sha256Final(Sha256 *ctx, unsigned char *digest);
+void pbkdf2Sha256(const void *key, size_t keyLen, const void *salt, size_t saltLen,
+                  unsigned int iterations, unsigned char *out, size_t outLen);
+int scrypt(const char *password, const unsigned char *salt, size_t saltLen,
+           int log2N, int r, int p, unsigned char *out, size_t outLen);
+int constantTimeEqual(const unsigned char *a, const unsigned char *b, size_t len);
+int isPasswordHash(const char *stored);
+int passwordHash(const char *password, char *out);
+int passwordVerify(const char *password, const char *stored);
+void kdfRun(KdfJob *jobs, int count);
+int migratePasswords();
+
 // Authentication
 void register_user();
 int login_user();
@@ -76,32 +961,265 @@ void mainMenu(int userIndex);
 void adminMenu();
 void customerMenu(const char *username);
 
+// Lookups
+unsigned int hashString(const char *s);
+void userHashInsert(int index);
+void userHashRebuild();
+int findUserIndex(const char *username);
+int findCarIndex(int id);
+int findRentalIndex(int rentalId);
+int findCarByName(const char *brand, const char *model);
+unsigned int carNameHash(int brand, int model);
+int carNameFind(int brand, int model);
+void carNameAdd(int slot);
+void carNameRemove(int slot);
+void carNameRebuild();
+int allocCarSlot();
+int insertCar(const Car *c);
+void setCarAvailable(int index, int available);
+void removeCarAt(int index);
+void rebuildCarIndexes();
+int liveCarCount();
+IntVec *customerRentals(int user);
+void customerRentalAdd(int slot);
+void customerRentalsRebuild();
+int resolveRentalStatus();
+
+// Listing output
+void bufPrintf(OutBuf *out, const char *fmt, ...);
+void bufFlush(OutBuf *out);
+int bufWrite(OutBuf *out, int fd);
+int pagePrompt(int *offset, int total);
+
 // Car functions
 void addCar();
 void listCars();
 void deleteCar();
+void searchCars();
+void topCars();
+void findCars();
+void findCustomers();
+void importCars();
+void exportCars();
 
 // Rental functions
 void rentCar(const char *username);
-void returnCar();
+void returnCar(const char *username);
 void listRentals();
+void listMyRentals(const char *username);
+void checkAvailability();
 
 // File handling
 void loadData();
 void saveData();
+int writeSection(FILE *fp, SnapshotSection *sec, long long *pos, const Table *t, const void *data, size_t elemSize, long long count);
+void loadIntSection(IntVec *v, const char *base, const SnapshotSection *sec);
+int loadSnapshot();
+void importText();
+int importTextFile(const char *path, int kind);
+void *parseTextChunk(void *arg);
+const char *parseTextRecord(int kind, char **fields, int n, TextRecord *rec);
+int parseIntField(const char *s, int *out);
+int parseFloatField(const char *s, float *out);
+void exportText();
+
+// Journal
+void journalOpen();
+void journalClose();
+void journalAppend(const char *fmt, ...);
+void journalAppendText(const char *text, size_t len, int records);
+void journalCommit();
+void journalFlushLocked();
+void *journalWriter(void *arg);
+void journalReplay(long long from, long long to);
+void checkpoint();
+
+// Shared state
+void sharedOpen();
+int sharedAttach();
+void sharedClose();
+void sharedLock();
+void sharedUnlock();
+void sharedBegin();
+void sharedEnd();
+void sharedSync();
+int sharedAlone();
+void sharedAwaitWrites();
+void sharedAwaitLockless();
+unsigned long long processStart(pid_t pid);
+
+// Sorted indexes
+void skipInsert(SkipList *list, int slot);
+void skipRemove(SkipList *list, int slot);
+void skipBuild(SkipList *list, int *slots, int count);
+SkipNode *skipSeek(SkipList *list, int offset);
+void carIndexAdd(int slot);
+void carIndexRemove(int slot);
+void carIndexRebuild();
+void printCarRow(OutBuf *out, const Car *c);
+
+// Reservations
+int dayFromDate(int year, int month, int day);
+void formatDay(int day, char *out);
+int parseDay(const char *s);
+int today();
+BookingVec *carBookings(int slot);
+int bookingOverlap(const BookingVec *b, int startDay, int endDay);
+int bookingConflict(const BookingVec *b, int startDay, int endDay);
+int bookingCovers(const BookingVec *b, int day);
+void bookingAdd(BookingVec *b, int startDay, int endDay, int rentalSlot);
+void bookingRemove(BookingVec *b, int rentalSlot);
+void carBookingsRebuild();
+void availabilityRefresh();
+
+// Rental history
+int varintPut(unsigned char *p, unsigned int v);
+const unsigned char *varintGet(const unsigned char *p, const unsigned char *end, unsigned int *v);
+int historyEncode(unsigned char *p, const Rental *r, const Rental *prev);
+const unsigned char *historyDecode(const unsigned char *p, const unsigned char *end, Rental *r, const Rental *prev);
+int historyWriteSegment(int segment, const Rental *rentals, int count);
+Rental *historyReadSegment(int segment, int *count);
+const Rental *historyAt(int index);
+int historyFind(const char *username, Rental **found);
+void historyRefAdd(int segment, const Rental *rentals, int count);
+void historyRefsRebuild();
+void historyPrune();
+int archiveRentals();
+
+// Metrics
+long long nowNanos();
+void metricRecord(int metric, long long start, int ok);
+int metricResult(int metric, long long start, int result);
+int metricBucket(unsigned long long ns);
+unsigned long long metricBucketValue(int bucket);
+unsigned long long metricPercentile(const Metric *m, double fraction);
+void statsFormat(OutBuf *out);
+void statsScreen();
+void statsWrite();
+void *statsWriter(void *arg);
+
+// Columnar search
+int brandFind(const char *brand);
+int brandIntern(const char *brand);
+
+// Aggregates
+RentalTotals *carStats(int slot);
+RentalTotals *customerStats(int user);
+static inline BrandStats *brandAt(int id) { return (BrandStats *)tableAt(&brandTable, id); }
+static inline BrandStats *branchAt(int id) { return (BrandStats *)tableAt(&branchTable, id); }
+void statsCarAdded(int slot);
+void statsCarRemoved(int slot);
+void statsCarRented(int slot, int delta);
+void statsRentalAdded(int rentalSlot, int carSlot);
+void statsRentalCancelled(int rentalSlot, int carSlot);
+int statsRebuild();
+void statsRecount();
+void rankInsert(int *top, double *keys, int *count, int limit, int id, double key);
+double percent(int part, int whole);
+void revenueReport();
+void carColumnsSet(CarColumns *c, int row, int slot);
+int searchBlock(const CarColumns *c, const CarQuery *q, int brandId, int start, int count, int *hits);
+
+// Branch shards
+int branchFind(const char *branch);
+int branchIntern(const char *branch);
+static inline Shard *shardAt(int branch) { return (Shard *)tableAt(&shardTable, branch); }
+pthread_mutex_t *carShardLock(int slot);
+void shardAdd(int slot);
+void shardRemove(int slot);
+void shardUpdate(int slot);
+void shardsRebuild();
+void *shardScanPart(void *arg);
+void shardScan(ShardScan *scan, IntVec *hits);
+void sortCarSlots(IntVec *slots);
+
+// Top-K
+int topKindFind(const char *name);
+int topBetter(const TopEntry *a, const TopEntry *b);
+void topPush(TopHeap *h, TopEntry e);
+void topSiftDown(TopHeap *h, TopEntry e);
+void topSort(TopHeap *h, IntVec *slots);
+TopEntry topEntry(int kind, int slot);
+void topFromIndex(int kind, int k, IntVec *hits);
 
-// Sorting Prototypes 
-void sortById();
-void sortByBrand();
-void sortByModel();
-void sortByYear();
-void sortByPrice();
-void sortByStatus();
+// Name search
+static inline TrieNode *trieAt(const Dictionary *d, int node) { return (TrieNode *)tableAt(&d->trie, node); }
+void trieInsert(Dictionary *d, int id);
+void trieRebuild(Dictionary *d);
+void trieVisit(NameSearch *s, int node, const int *row, int best);
+int dictSearch(const Dictionary *d, const char *query, int limit, IntVec *ids, IntVec *typos);
+void carsNamed(SkipList *index, int isBrand, int id, IntVec *hits);
 
 // --------------------------- MAIN ---------------------------
-int main()
+int main(int argc, char *argv[])
 {
+    // --kdf-cost LOG2N and --durability MODE may precede any mode
+    int kdfCostGiven = 0;
+    while (argc >= 3 && (strcmp(argv[1], "--kdf-cost") == 0 || strcmp(argv[1], "--durability") == 0))
+    {
+        if (strcmp(argv[1], "--kdf-cost") == 0)
+        {
+            int cost = atoi(argv[2]);
+            if (cost < 1 || cost > KDF_MAX_LOG2N)
+            {
+                printf("❌ --kdf-cost must be between 1 and %d.\n", KDF_MAX_LOG2N);
+                return EXIT_FAILURE;
+            }
+            kdfLog2N = cost;
+            kdfCostGiven = 1;
+        }
+        else if (strcmp(argv[2], "sync") == 0 || strcmp(argv[2], "async") == 0)
+            journalMode = strcmp(argv[2], "sync") == 0 ? JOURNAL_SYNC : JOURNAL_ASYNC;
+        else
+        {
+            printf("❌ --durability must be sync or async.\n");
+            return EXIT_FAILURE;
+        }
+        argv[2] = argv[0];
+        argv += 2;
+        argc -= 2;
+    }
+
+    // These work on generated data and must not load or touch the real files
+    if (!kdfCostGiven && argc > 1 && (strcmp(argv[1], "--generate") == 0 || strcmp(argv[1], "--bench") == 0))
+        kdfLog2N = BENCH_KDF_LOG2N;
+    if (argc == 3 && strcmp(argv[1], "--generate") == 0 && atoi(argv[2]) > 0)
+    {
+        generateData(atoi(argv[2]));
+        return EXIT_SUCCESS;
+    }
+    if ((argc == 3 || argc == 4) && strcmp(argv[1], "--bench") == 0 && atoi(argv[2]) > 0)
+        return runBenchmarks(atoi(argv[2]), argc == 4 ? argv[3] : BENCH_DEFAULT_OUTPUT) == -1 ? EXIT_FAILURE : EXIT_SUCCESS;
+
+    sharedOpen();
+    sharedLock();
     loadData();
+    sharedUnlock();
+    journalOpen();
+    pthread_t statsThread;
+    if (pthread_create(&statsThread, NULL, statsWriter, NULL) == 0)
+        pthread_detach(statsThread);
+
+    if (argc == 3 && strcmp(argv[1], "--batch") == 0)
+    {
+        int result = runBatch(argv[2]);
+        sharedLock();
+        archiveRentals();
+        sharedUnlock();
+        sharedClose();
+        statsWrite();
+        return result == -1 ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+    if ((argc == 3 || argc == 4) && strcmp(argv[1], "--serve") == 0)
+    {
+        int workers = argc == 4 && atoi(argv[3]) > 0 ? atoi(argv[3]) : SERVER_DEFAULT_WORKERS;
+        return runServer(argv[2], workers) == -1 ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+    if (argc > 1)
+    {
+        printf("Usage: %s [--kdf-cost LOG2N] [--durability sync|async] [--batch FILE | --serve SOCKET [WORKERS] | --generate N | --bench N [OUTPUT.csv]]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
 
     int option, user_index;
     while (1)
@@ -126,13 +1244,12 @@ int main()
         {
         case 1:
             register_user();
-            saveData();
             break;
         case 2:
             user_index = login_user();
             if (user_index >= 0)
             {
-                printf("\n✅ Login Successful! Welcome %s.\n", users[user_index].username);
+                printf("\n✅ Login Successful! Welcome %s.\n", userAt(user_index)->username);
                 mainMenu(user_index);
             }
             else
@@ -142,7 +1259,11 @@ int main()
             break;
         case 3:
             printf("\nExiting...\n");
-            saveData();
+            sharedLock();
+            archiveRentals();
+            sharedUnlock();
+            sharedClose();
+            statsWrite();
             return 0;
         default:
             printf("\nInvalid choice. Try again.\n");
@@ -151,258 +1272,2426 @@ int main()
     }
 }
 
-// --------------------------- Authentication ---------------------------
+// --------------------------- Storage ---------------------------
+void *xrealloc(void *p, size_t size)
+{
+    p = realloc(p, size);
+    if (!p)
+    {
+        fprintf(stderr, "❌ Out of memory!\n");
+        exit(EXIT_FAILURE);
+    }
+    return p;
+}
 
-void register_user()
+void *arenaAlloc(Arena *arena, size_t size)
 {
-    if (user_count == MAX_USER)
+    size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+
+    ArenaBlock *block = arena->head;
+    if (!block || block->size - block->used < size)
     {
-        printf("\n❌ Maximum %d users supported.\n", MAX_USER);
-        return;
+        size_t blockSize = size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE;
+        block = xrealloc(NULL, sizeof(ArenaBlock) + blockSize);
+        block->size = blockSize;
+        block->used = 0;
+        block->next = arena->head;
+        arena->head = block;
     }
 
-    char username[CREDENTIAL_LENGTH], password[CREDENTIAL_LENGTH];
-    input_credentials(username, password);
+    void *p = block->data + block->used;
+    block->used += size;
+    return p;
+}
 
-    // Check for duplicate username
-    for (int i = 0; i < user_count; i++)
+void *tableAppend(Table *t)
+{
+    int chunk = t->count >> TABLE_CHUNK_SHIFT;
+    if (chunk == t->chunkCount)
     {
-        if (strcmp(username, users[i].username) == 0)
+        if (t->chunkCount == t->chunkCap)
         {
-            printf("❌ Username already exists! Try another.\n");
-            return;
+            t->chunkCap = t->chunkCap ? t->chunkCap * 2 : 16;
+            t->chunks = xrealloc(t->chunks, t->chunkCap * sizeof(void *));
         }
+        t->chunks[t->chunkCount++] = arenaAlloc(t->arena, TABLE_CHUNK_SIZE * t->elemSize);
     }
 
-    int index = user_count;
-    strcpy(users[index].username, username);
-    strcpy(users[index].password, password);
+    void *slot = tableAt(t, t->count++);
+    memset(slot, 0, t->elemSize);
+    return slot;
+}
 
-    int choice;
-    printf("Do you want to register as Admin? (1=Yes, 0=No): ");
-    if (scanf("%d", &choice) != 1)
-        choice = 0;
-    while (getchar() != '\n')
-        ;
+// Forget all records but keep the chunks for reuse.
+void tableClear(Table *t)
+{
+    t->count = 0;
+}
 
-    if (choice == 1)
+// Use records that are already laid out back to back in memory (a mapped
+// snapshot) as the table's contents. Whole chunks are used in place; only
+// the partial last chunk is copied so appends have somewhere to go.
+void tableAttach(Table *t, char *base, int count)
+{
+    int full = count >> TABLE_CHUNK_SHIFT;
+    if (full + 1 > t->chunkCap)
     {
-        char adminKey[50];
-        printf("Enter Admin Authentication Key: ");
-        fgets(adminKey, sizeof(adminKey), stdin);
-        fix_gets_input(adminKey);
+        t->chunks = xrealloc(t->chunks, (full + 1) * sizeof(void *));
+        t->chunkCap = full + 1;
+    }
 
-        if (strcmp(adminKey, ADMIN_KEY) == 0)
-        {
-            users[index].isAdmin = 1;
-            printf("\n✅ Admin registration successful!\n");
-        }
-        else
-        {
-            users[index].isAdmin = 0;
-            printf("\n❌ Invalid key! Registered as Customer.\n");
-        }
+    for (int k = 0; k < full; k++)
+        t->chunks[k] = base + (size_t)k * TABLE_CHUNK_SIZE * t->elemSize;
+    t->chunkCount = full;
+    t->count = full << TABLE_CHUNK_SHIFT;
+
+    for (int i = t->count; i < count; i++)
+        memcpy(tableAppend(t), base + (size_t)i * t->elemSize, t->elemSize);
+}
+
+void intVecPush(IntVec *v, int value)
+{
+    if (v->count == v->cap)
+    {
+        v->cap = v->cap ? v->cap * 2 : 16;
+        v->items = xrealloc(v->items, v->cap * sizeof(int));
     }
-    else
+    v->items[v->count++] = value;
+}
+
+// Grow or shrink to count entries; new entries are zero.
+void intVecResize(IntVec *v, int count)
+{
+    if (count > v->cap)
     {
-        users[index].isAdmin = 0;
-        printf("\n✅ Registered as Customer.\n");
+        int cap = v->cap ? v->cap : 16;
+        while (cap < count)
+            cap *= 2;
+        v->items = xrealloc(v->items, cap * sizeof(int));
+        v->cap = cap;
     }
+    if (count > v->count)
+        memset(v->items + v->count, 0, (count - v->count) * sizeof(int));
+    v->count = count;
+}
 
-    user_count++;
-    printf("\n✅ Registration Completed!\n");
+// Pass slot -1 to forget an id.
+void idMapSet(IntVec *map, int id, int slot)
+{
+    if (id >= map->count)
+        intVecResize(map, id + 1);
+    map->items[id] = slot + 1;
 }
 
-int login_user()
+int idMapGet(const IntVec *map, int id)
 {
-    char username[CREDENTIAL_LENGTH];
-    char password[CREDENTIAL_LENGTH];
+    if (id <= 0 || id >= map->count)
+        return -1;
+    return map->items[id] - 1;
+}
 
-    input_credentials(username, password);
+// Returns the name's id, or -1 if it has never been added.
+int dictFind(const Dictionary *d, const char *name)
+{
+    if (!d->slotCap)
+        return -1;
+    unsigned int mask = d->slotCap - 1;
+    for (unsigned int slot = hashString(name) & mask; d->slots[slot]; slot = (slot + 1) & mask)
+        if (strcmp(dictName(d, d->slots[slot] - 1), name) == 0)
+            return d->slots[slot] - 1;
+    return -1;
+}
 
-    for (int i = 0; i < user_count; i++)
+// Returns the name's id, adding it if needed (cut to the record size).
+int dictIntern(Dictionary *d, const char *name)
+{
+    char key[CUSTOMER_NAME_LENGTH];
+    snprintf(key, d->names.elemSize < sizeof(key) ? d->names.elemSize : sizeof(key), "%s", name);
+    int id = dictFind(d, key);
+    if (id != -1)
+        return id;
+
+    id = d->names.count;
+    snprintf(tableAppend(&d->names), d->names.elemSize, "%s", key);
+    if ((id + 1) * 2 > d->slotCap)
     {
-        if (strcmp(username, users[i].username) == 0 && strcmp(password, users[i].password) == 0)
-            return i;
+        dictRebuild(d);
+        return id;
     }
-    return -1;
+    unsigned int mask = d->slotCap - 1;
+    unsigned int slot = hashString(key) & mask;
+    while (d->slots[slot])
+        slot = (slot + 1) & mask;
+    d->slots[slot] = id + 1;
+    trieInsert(d, id);
+    return id;
 }
 
-void input_credentials(char *username, char *password)
+// Order two ids by their names: by rank when both have one, else by text.
+int dictCompare(const Dictionary *d, int a, int b)
 {
-    printf("\nEnter username: ");
-    fgets(username, CREDENTIAL_LENGTH, stdin);
-    fix_gets_input(username);
+    if (a == b)
+        return 0;
+    if (a < d->ranked && b < d->ranked)
+        return d->rank.items[a] - d->rank.items[b];
+    return strcmp(dictName(d, a), dictName(d, b));
+}
 
-    printf("Enter password: ");
-    fflush(stdout);
+void dictClear(Dictionary *d)
+{
+    tableClear(&d->names);
+    dictRebuild(d);
+}
 
-    struct termios old_props, new_props;
-    tcgetattr(STDIN_FILENO, &old_props);
-    new_props = old_props;
-    new_props.c_lflag &= ~(ECHO | ICANON);
-    tcsetattr(STDIN_FILENO, TCSANOW, &new_props);
+int compareDictIds(const void *a, const void *b)
+{
+    return strcmp(dictName(dictSorting, *(const int *)a), dictName(dictSorting, *(const int *)b));
+}
 
-    char ch;
-    int i = 0;
-    while ((ch = getchar()) != '\n' && ch != EOF && i < CREDENTIAL_LENGTH - 1)
+// Recompute the hash, the ranks and the trie from the names, after loading
+// them or when the hash fills up.
+void dictRebuild(Dictionary *d)
+{
+    int cap = 16;
+    while (cap < (d->names.count + 1) * 2)
+        cap *= 2;
+    free(d->slots);
+    d->slots = xrealloc(NULL, cap * sizeof(int));
+    memset(d->slots, 0, cap * sizeof(int));
+    d->slotCap = cap;
+
+    intVecResize(&d->order, d->names.count);
+    intVecResize(&d->rank, d->names.count);
+    for (int i = 0; i < d->names.count; i++)
     {
-        if (ch == '\b' || ch == 127)
+        unsigned int slot = hashString(dictName(d, i)) & (cap - 1);
+        while (d->slots[slot])
+            slot = (slot + 1) & (cap - 1);
+        d->slots[slot] = i + 1;
+        d->order.items[i] = i;
+    }
+    dictSorting = d;
+    qsort(d->order.items, d->order.count, sizeof(int), compareDictIds);
+    for (int i = 0; i < d->order.count; i++)
+        d->rank.items[d->order.items[i]] = i;
+    d->ranked = d->names.count;
+    trieRebuild(d);
+}
+
+// --------------------------- Operations ---------------------------
+// Each operation validates, applies and journals one change and returns -1
+// if it was rejected. Prompts and receipts stay in the menu functions.
+//
+// Operations are safe to call from several threads (server mode):
+//   - storeLock is taken for writing by anything that changes the shape of
+//     the data (register, add/delete car) and for reading by the rest;
+//   - rent and return hold the car's stripe lock while they check and flip
+//     its availability, so two customers can never rent the same car, and
+//     then take indexLock only for the short update of the shared status
+//     index, rental table and journal, and the car's shard lock for its
+//     bookings and search row;
+//   - searches and availability checks hold only the read lock and one
+//     shard lock at a time, so they never wait for indexLock;
+//   - the journal is written by its own thread; an operation returns once
+//     its record is queued, or once it is on disk with --durability sync;
+//   - changes also hold the shared lock, taken before storeLock, so that
+//     other instances in the directory see them in order (Shared State).
+
+pthread_mutex_t *carLock(int carId)
+{
+    return &carLocks[(unsigned int)carId % CAR_LOCK_STRIPES];
+}
+
+// Names go into comma-separated, one-per-line records (journal and text
+// files), so they must not be empty or contain a comma or line break, and
+// must fit in a field of size bytes: a longer one would be cut short and
+// could then match another name.
+int validName(const char *name, size_t size)
+{
+    return name[0] != '\0' && strlen(name) < size && strpbrk(name, ",\r\n") == NULL;
+}
+
+int doRegister(const char *username, const char *password, int isAdmin)
+{
+    long long t0 = nowNanos();
+    if (!validName(username, CREDENTIAL_LENGTH) || strlen(password) >= CREDENTIAL_LENGTH)
+        return metricResult(METRIC_REGISTER, t0, -1);
+
+    // Hash before taking the lock; the derivation is the slow part
+    KdfJob job = {0};
+    snprintf(job.password, sizeof(job.password), "%s", password);
+    kdfRun(&job, 1);
+    if (job.result != 0)
+        return metricResult(METRIC_REGISTER, t0, -1);
+
+    sharedBegin();
+    pthread_rwlock_wrlock(&storeLock);
+    if (findUserIndex(username) != -1)
+    {
+        pthread_rwlock_unlock(&storeLock);
+        sharedEnd();
+        return metricResult(METRIC_REGISTER, t0, -1);
+    }
+
+    User *u = tableAppend(&userTable);
+    snprintf(u->username, sizeof(u->username), "%s", username);
+    memcpy(u->password, job.hash, sizeof(u->password));
+    u->isAdmin = isAdmin;
+    userHashInsert(userTable.count - 1);
+    dictIntern(&customerDict, u->username);
+    journalAppend("U,%s,%s,%d", u->username, u->password, u->isAdmin);
+    int index = userTable.count - 1;
+    pthread_rwlock_unlock(&storeLock);
+    sharedEnd();
+    journalCommit();
+    return metricResult(METRIC_REGISTER, t0, index);
+}
+
+// Returns the user index. An unknown user is checked against a dummy hash
+// so the reply takes as long as a wrong password.
+int doLogin(const char *username, const char *password)
+{
+    long long t0 = nowNanos();
+    KdfJob job = {.verify = 1};
+    snprintf(job.password, sizeof(job.password), "%s", password);
+
+    sharedSync();
+    pthread_rwlock_rdlock(&storeLock);
+    int i = findUserIndex(username);
+    if (i != -1)
+        memcpy(job.hash, userAt(i)->password, sizeof(job.hash));
+    pthread_rwlock_unlock(&storeLock);
+    if (i == -1)
+        snprintf(job.hash, sizeof(job.hash), KDF_PREFIX "%d$%d$%d$%032d$%064d", kdfLog2N, KDF_R, KDF_P, 0, 0);
+
+    kdfRun(&job, 1);
+    return metricResult(METRIC_LOGIN, t0, job.result == 1 ? i : -1);
+}
+
+// Returns the new car's id. branch "" is BRANCH_DEFAULT.
+int doAddCar(const char *brand, const char *model, int year, float pricePerDay, const char *branch)
+{
+    long long t0 = nowNanos();
+    Car c = {0};
+    if (!validName(brand, NAME_LENGTH) || !validName(model, NAME_LENGTH) || (branch[0] != '\0' && !validName(branch, NAME_LENGTH)))
+        return metricResult(METRIC_ADD_CAR, t0, -1);
+
+    sharedBegin();
+    pthread_rwlock_wrlock(&storeLock);
+    if (findCarByName(brand, model) != -1)
+    {
+        pthread_rwlock_unlock(&storeLock);
+        sharedEnd();
+        return metricResult(METRIC_ADD_CAR, t0, -1);
+    }
+
+    c.id = nextCarId++;
+    c.brand = brandIntern(brand);
+    c.model = dictIntern(&modelDict, model);
+    c.branch = branchIntern(branch);
+    c.year = year;
+    c.pricePerDay = pricePerDay;
+    c.isAvailable = 1;
+    insertCar(&c);
+    journalAppend("A,%d,%s,%s,%d,%.2f,%d,%s", c.id, carBrand(&c), carModel(&c), c.year, c.pricePerDay, c.isAvailable, carBranch(&c));
+    pthread_rwlock_unlock(&storeLock);
+    sharedEnd();
+    journalCommit();
+    return metricResult(METRIC_ADD_CAR, t0, c.id);
+}
+
+int doDeleteCar(int id)
+{
+    long long t0 = nowNanos();
+    sharedBegin();
+    pthread_rwlock_wrlock(&storeLock);
+    int found = findCarIndex(id);
+    if (found != -1 && carBookings(found)->count > 0)
+        found = -1; // still rented out or booked
+    if (found != -1)
+    {
+        removeCarAt(found);
+        journalAppend("D,%d", id);
+    }
+    pthread_rwlock_unlock(&storeLock);
+    sharedEnd();
+    journalCommit();
+    return metricResult(METRIC_DELETE_CAR, t0, found == -1 ? -1 : 0);
+}
+
+// Adds the cars of a fleet CSV file under new ids, skipping any whose
+// brand and model are already in the fleet (or earlier in the file). The
+// new cars are journaled in one write, for other instances to pick up,
+// and a checkpoint saves them before the lock is released, so the import
+// reaches the disk whole or not at all.
+// Returns the number of cars added, or -1 if the file cannot be read;
+// on success *duplicates gets the number skipped.
+int doImportCars(const char *path, int *duplicates)
+{
+    long long t0 = nowNanos();
+    sharedBegin();
+    pthread_rwlock_wrlock(&storeLock);
+    int before = liveCarCount(), firstId = nextCarId;
+    int parsed = importTextFile(path, TEXT_FLEET);
+    int added = liveCarCount() - before;
+    if (added > 0)
+    {
+        OutBuf out = {0};
+        for (int id = firstId; id < nextCarId; id++)
         {
-            if (i > 0)
-                i--;
-            printf("\b \b");
+            const Car *c = carAt(findCarIndex(id));
+            bufPrintf(&out, "A,%d,%s,%s,%d,%.2f,%d,%s\n", c->id, carBrand(c), carModel(c), c->year, c->pricePerDay, c->isAvailable, carBranch(c));
         }
-        else
+        journalAppendText(out.data, out.len, added);
+        free(out.data);
+        checkpoint();
+    }
+    pthread_rwlock_unlock(&storeLock);
+    sharedEnd();
+    if (parsed != -1)
+        *duplicates = parsed - added;
+    return metricResult(METRIC_IMPORT_CARS, t0, parsed == -1 ? -1 : added);
+}
+
+// Streams the fleet to path as a fleet CSV file, in id order, a block at
+// a time. Returns the number of cars written, or -1.
+int doExportCars(const char *path)
+{
+    long long t0 = nowNanos();
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1)
+        return metricResult(METRIC_EXPORT_CARS, t0, -1);
+
+    OutBuf out = {0};
+    bufPrintf(&out, "%s\n", FLEET_CSV_HEADER FLEET_CSV_BRANCH);
+    int count = 0, ok = 1;
+    sharedSync();
+    pthread_rwlock_rdlock(&storeLock);
+    for (SkipNode *n = carsById.head ? carsById.head->next[0].node : NULL; n && ok; n = n->next[0].node)
+    {
+        const Car *c = carAt(n->slot);
+        bufPrintf(&out, "%s,%s,%d,%.2f,%s\n", carBrand(c), carModel(c), c->year, c->pricePerDay, carBranch(c));
+        count++;
+        if (out.len >= FLEET_EXPORT_BLOCK)
+            ok = bufWrite(&out, fd);
+    }
+    pthread_rwlock_unlock(&storeLock);
+    ok = ok && bufWrite(&out, fd);
+    ok = close(fd) == 0 && ok;
+    free(out.data);
+    return metricResult(METRIC_EXPORT_CARS, t0, ok ? count : -1);
+}
+
+// Returns the new rental's id.
+// Books the car for days days from startDay (today or later); rejected if
+// that overlaps one of its open rentals. A rental starting today takes the
+// car out at once.
+int doRentCar(const char *username, int carId, int startDay, int days)
+{
+    long long t0 = nowNanos();
+    int rentalId = -1;
+    int now = today();
+    if (days < 1 || startDay < now)
+        return metricResult(METRIC_RENT, t0, -1);
+
+    sharedBegin();
+    pthread_rwlock_rdlock(&storeLock);
+    int found = findCarIndex(carId);
+    int customer = dictFind(&customerDict, username);
+    if (found != -1 && customer != -1)
+    {
+        pthread_mutex_lock(carLock(carId));
+        BookingVec *b = carBookings(found);
+        if (!bookingConflict(b, startDay, startDay + days))
         {
-            password[i++] = ch;
-            printf("*");
+            pthread_mutex_lock(&indexLock);
+            pthread_mutex_lock(carShardLock(found));
+            if (startDay == now)
+                setCarAvailable(found, 0);
+
+            Rental *r = tableAppend(&rentalTable);
+            r->rentalId = rentalId = nextRentalId++;
+            r->customer = customer;
+            r->carId = carId;
+            r->days = days;
+            r->totalCost = days * carAt(found)->pricePerDay;
+            r->isReturned = 0;
+            r->startDay = startDay;
+            r->endDay = startDay + days;
+            idMapSet(&rentalSlotById, r->rentalId, rentalTable.count - 1);
+            customerRentalAdd(rentalTable.count - 1);
+            bookingAdd(b, r->startDay, r->endDay, rentalTable.count - 1);
+            pthread_mutex_unlock(carShardLock(found));
+            statsRentalAdded(rentalTable.count - 1, found);
+            journalAppend("R,%d,%s,%d,%d,%.2f,%d", r->rentalId, rentalCustomer(r), r->carId, r->days, r->totalCost, r->startDay);
+            pthread_mutex_unlock(&indexLock);
         }
+        pthread_mutex_unlock(carLock(carId));
     }
-    password[i] = '\0';
-    tcsetattr(STDIN_FILENO, TCSANOW, &old_props);
-    printf("\n");
+    pthread_rwlock_unlock(&storeLock);
+    sharedEnd();
+    journalCommit();
+    return metricResult(METRIC_RENT, t0, rentalId);
 }
 
-void fix_gets_input(char *s)
+// Only the customer who made a rental can return it, and only once.
+int doReturnCar(const char *username, int rentalId)
 {
-    int pos = strcspn(s, "\n");
-    s[pos] = '\0';
+    long long t0 = nowNanos();
+    int result = -1;
+
+    sharedBegin();
+    pthread_rwlock_rdlock(&storeLock);
+    pthread_mutex_lock(&indexLock);
+    int found = findRentalIndex(rentalId);
+    int carId = found == -1 || rentalAt(found)->customer != dictFind(&customerDict, username) ? 0 : rentalAt(found)->carId;
+    pthread_mutex_unlock(&indexLock);
+
+    if (carId)
+    {
+        // Mark car available again; isReturned is checked under the car's
+        // lock so two returns of one rental cannot both succeed
+        pthread_mutex_lock(carLock(carId));
+        pthread_mutex_lock(&indexLock);
+        Rental *r = rentalAt(found);
+        if (!r->isReturned)
+        {
+            // Returning a booking that has not started cancels it: it
+            // brings in nothing and no longer counts as a rental
+            int cancelled = r->startDay > today();
+            r->isReturned = 1;
+            int carIndex = findCarIndex(carId);
+            if (cancelled)
+                statsRentalCancelled(found, carIndex);
+            if (carIndex != -1)
+            {
+                BookingVec *b = carBookings(carIndex);
+                pthread_mutex_lock(carShardLock(carIndex));
+                bookingRemove(b, found);
+                setCarAvailable(carIndex, !bookingCovers(b, today()));
+                pthread_mutex_unlock(carShardLock(carIndex));
+            }
+            journalAppend("T,%d,%d", rentalId, cancelled);
+            result = 0;
+        }
+        pthread_mutex_unlock(&indexLock);
+        pthread_mutex_unlock(carLock(carId));
+    }
+    pthread_rwlock_unlock(&storeLock);
+    sharedEnd();
+    journalCommit();
+    return metricResult(METRIC_RETURN, t0, result);
 }
 
-// --------------------------- Menus ---------------------------
-void mainMenu(int userIndex)
+// Fills hits with the slots of matching cars, in slot order; returns the
+// number of hits. Only the query's branch is scanned if it names one, all
+// shards otherwise; each shard's statuses are seen at one instant.
+int doSearchCars(const CarQuery *q, IntVec *hits)
 {
-    if (users[userIndex].isAdmin)
+    long long t0 = nowNanos();
+    hits->count = 0;
+    sharedSync();
+    pthread_rwlock_rdlock(&storeLock);
+    ShardScan scan = {.query = q, .brandId = -1, .branch = -1};
+    if ((q->brand[0] != '\0' && (scan.brandId = brandFind(q->brand)) == -1) ||
+        (q->branch && q->branch[0] != '\0' && (scan.branch = branchFind(q->branch)) == -1))
     {
-         printf("\n---------------------------------------------------------------------------------\n");
-        printf("Admin Menu\n");
-        printf("---------------------------------------------------------------------------------\n");
-        adminMenu();
+        pthread_rwlock_unlock(&storeLock);
+        return metricResult(METRIC_SEARCH, t0, 0); // a brand or branch no car has ever had
+    }
+    shardScan(&scan, hits);
+    sortCarSlots(hits);
+    pthread_rwlock_unlock(&storeLock);
+    return metricResult(METRIC_SEARCH, t0, hits->count);
+}
+
+// Fills hits with the slots of cars of branch (every branch if "") with
+// no booking in [startDay, endDay), in slot order; each car costs one
+// binary search of its bookings.
+int doFreeCars(int startDay, int endDay, const char *branch, IntVec *hits)
+{
+    long long t0 = nowNanos();
+    hits->count = 0;
+    sharedSync();
+    pthread_rwlock_rdlock(&storeLock);
+    ShardScan scan = {.startDay = startDay, .endDay = endDay, .branch = -1};
+    if (branch[0] != '\0' && (scan.branch = branchFind(branch)) == -1)
+    {
+        pthread_rwlock_unlock(&storeLock);
+        return metricResult(METRIC_AVAILABILITY, t0, 0);
+    }
+    shardScan(&scan, hits);
+    sortCarSlots(hits);
+    pthread_rwlock_unlock(&storeLock);
+    return metricResult(METRIC_AVAILABILITY, t0, hits->count);
+}
 
+// Fills hits with the slots of the k best available cars of branch
+// (every branch if "") by kind (TOP_*), best first; returns their number.
+int doTopCars(int kind, int k, const char *branch, IntVec *hits)
+{
+    long long t0 = nowNanos();
+    hits->count = 0;
+    if (k < 1)
+        return metricResult(METRIC_TOP_CARS, t0, -1);
+    sharedSync();
+    pthread_rwlock_rdlock(&storeLock);
+    ShardScan scan = {.branch = -1, .topKind = kind};
+    if (branch[0] != '\0' && (scan.branch = branchFind(branch)) == -1)
+    {
+        pthread_rwlock_unlock(&storeLock);
+        return metricResult(METRIC_TOP_CARS, t0, 0);
+    }
+    if (scan.branch == -1 && kind != TOP_MOST_RENTED)
+    {
+        pthread_mutex_lock(&indexLock);
+        topFromIndex(kind, k, hits);
+        pthread_mutex_unlock(&indexLock);
     }
     else
     {
-        printf("\n---------------------------------------------------------------------------------\n");
-        printf("Customer Menu\n");
-        printf("---------------------------------------------------------------------------------\n");
-        customerMenu(users[userIndex].username);
+        // Rental counts are read under the shard locks only, so a rental
+        // made during the scan may or may not be counted.
+        scan.heap = (TopHeap){xrealloc(NULL, k * sizeof(TopEntry)), 0, k};
+        shardScan(&scan, hits);
+        topSort(&scan.heap, hits);
+        free(scan.heap.items);
+    }
+    pthread_rwlock_unlock(&storeLock);
+    return metricResult(METRIC_TOP_CARS, t0, hits->count);
+}
+
+// Fills hits with the slots of the cars whose brand or model matches text
+// (a prefix, with small typos allowed; see dictSearch()). Cars of closer
+// matches come first, brands before models on a tie, then by name and id.
+// Returns the number of cars, -1 if text is empty.
+int doFindCars(const char *text, IntVec *hits)
+{
+    long long t0 = nowNanos();
+    hits->count = 0;
+    if (text[0] == '\0')
+        return metricResult(METRIC_FIND_NAME, t0, -1);
+    sharedSync();
+    pthread_rwlock_rdlock(&storeLock);
+    static __thread IntVec brands = {0}, brandTypos = {0}, models = {0}, modelTypos = {0};
+    dictSearch(&brandDict, text, FIND_NAMES, &brands, &brandTypos);
+    dictSearch(&modelDict, text, FIND_NAMES, &models, &modelTypos);
+    for (int i = 0, j = 0; i < brands.count || j < models.count;)
+    {
+        if (j == models.count || (i < brands.count && brandTypos.items[i] <= modelTypos.items[j]))
+            carsNamed(&carsByBrand, 1, brands.items[i++], hits);
+        else
+            carsNamed(&carsByModel, 0, models.items[j++], hits);
+    }
 
+    // A car can match by brand and by model; keep its first place
+    static __thread unsigned long long *seen = NULL;
+    static __thread int words = 0;
+    int need = (carTable.count + 63) / 64;
+    if (need > words)
+    {
+        seen = xrealloc(seen, need * sizeof(*seen));
+        memset(seen + words, 0, (need - words) * sizeof(*seen));
+        words = need;
+    }
+    int kept = 0;
+    for (int i = 0; i < hits->count; i++)
+    {
+        int slot = hits->items[i];
+        if (!(seen[slot >> 6] & 1ULL << (slot & 63)))
+        {
+            seen[slot >> 6] |= 1ULL << (slot & 63);
+            hits->items[kept++] = slot;
+        }
     }
+    hits->count = kept;
+    for (int i = 0; i < kept; i++)
+        seen[hits->items[i] >> 6] = 0;
+    pthread_rwlock_unlock(&storeLock);
+    return metricResult(METRIC_FIND_NAME, t0, hits->count);
 }
 
-void adminMenu()
+// Fills users with the customers (not admins) whose names match text,
+// closest first. Returns their number, -1 if text is empty.
+int doFindCustomers(const char *text, IntVec *users)
 {
-    int choice;
-    do
+    long long t0 = nowNanos();
+    users->count = 0;
+    if (text[0] == '\0')
+        return metricResult(METRIC_FIND_NAME, t0, -1);
+    sharedSync();
+    pthread_rwlock_rdlock(&storeLock);
+    static __thread IntVec names = {0}, typos = {0};
+    dictSearch(&customerDict, text, FIND_NAMES, &names, &typos);
+    for (int i = 0; i < names.count; i++)
     {
-        printf("\nAdmin Menu\n");
-        printf("1. Add Car\n2. List Cars\n3. Delete Car\n4. Back to Main Menu\n");
-        printf("Enter choice: ");
-        if (scanf("%d", &choice) != 1)
-            choice = 4;
-        while (getchar() != '\n')
-            ;
+        int user = findUserIndex(dictName(&customerDict, names.items[i]));
+        if (user != -1 && !userAt(user)->isAdmin)
+            intVecPush(users, user);
+    }
+    pthread_rwlock_unlock(&storeLock);
+    return metricResult(METRIC_FIND_NAME, t0, users->count);
+}
 
-        switch (choice)
+// --------------------------- Commands ---------------------------
+// Batch files and server sessions speak the same line protocol: one
+// command per line, fields separated by commas as in the data files.
+//   register,username,password[,isAdmin,adminKey]  (isAdmin 1 needs ADMIN_KEY)
+//   login,username,password
+//   logout
+//   addcar,brand,model,year,price[,branch]  (admin)
+//   deletecar,carId                      (admin)
+//   rentcar,carId,days[,YYYY-MM-DD]      (customer; starts today by default)
+//   returncar,rentalId                   (customer)
+//   importcars,file.csv                  (admin; see doImportCars)
+//   exportcars,file.csv                  (admin)
+//   topcars,cheapest|newest|rented,k[,branch]  (the best car's ID, 0 if none)
+// Commands run through the same operations as the menus, with no prompts.
+
+const Command commands[COMMAND_COUNT] = {
+    [COMMAND_REGISTER] = {"register", 3},
+    [COMMAND_LOGIN] = {"login", 3},
+    [COMMAND_LOGOUT] = {"logout", 1},
+    [COMMAND_ADD_CAR] = {"addcar", 5},
+    [COMMAND_DELETE_CAR] = {"deletecar", 2},
+    [COMMAND_RENT_CAR] = {"rentcar", 3},
+    [COMMAND_RETURN_CAR] = {"returncar", 2},
+    [COMMAND_IMPORT_CARS] = {"importcars", 2},
+    [COMMAND_EXPORT_CARS] = {"exportcars", 2},
+    [COMMAND_TOP_CARS] = {"topcars", 3},
+};
+
+double nowSeconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Split line in place at commas; returns the number of fields.
+int splitFields(char *line, char **fields, int maxFields)
+{
+    line[strcspn(line, "\r\n")] = '\0';
+    int n = 0;
+    fields[n++] = line;
+    for (char *p = line; *p && n < maxFields; p++)
+    {
+        if (*p == ',')
         {
-        case 1:
-            addCar();
-            saveData();
-            break;
-        case 2:
-            listCars();
-            break;
-        case 3:
-            deleteCar();
-            saveData();
-            break;
-        case 4:
-            return;
-        default:
-            printf("Invalid choice!\n");
+            *p = '\0';
+            fields[n++] = p + 1;
         }
-    } while (choice != 4);
+    }
+    return n;
 }
 
-void customerMenu(const char *username)
+// Parse and run one command line for a session. Returns the command, or
+// -1 if the line is not a valid command; *result gets the operation's
+// return value (-1 if it was rejected or not permitted).
+int executeCommand(Session *session, char *line, int *result)
 {
-    int choice;
-    do
+    char *f[COMMAND_MAX_FIELDS];
+    int n = splitFields(line, f, COMMAND_MAX_FIELDS);
+    int op = 0;
+    while (op < COMMAND_COUNT && strcmp(f[0], commands[op].name) != 0)
+        op++;
+    if (op == COMMAND_COUNT || n < commands[op].minFields)
+        return -1;
+
+    int isAdmin = session->user != -1 && session->isAdmin;
+    int isCustomer = session->user != -1 && !session->isAdmin;
+    *result = -1;
+    switch (op)
     {
-        printf("\nCustomer Menu\n");
-        printf("1. List Cars\n2. Rent Car\n3. Return Car\n4. List Rentals\n5. Back to Main Menu\n");
-        printf("Enter choice: ");
-        if (scanf("%d", &choice) != 1)
-            choice = 5;
-        while (getchar() != '\n')
-            ;
+    case COMMAND_REGISTER:
+        // Admins need the same key as at the Register prompt
+        if (n > 3 && atoi(f[3]) == 1)
+        {
+            if (n > 4 && strcmp(f[4], ADMIN_KEY) == 0)
+                *result = doRegister(f[1], f[2], 1);
+        }
+        else
+            *result = doRegister(f[1], f[2], 0);
+        break;
+    case COMMAND_LOGIN:
+        *result = session->user = doLogin(f[1], f[2]);
+        if (session->user != -1)
+        {
+            pthread_rwlock_rdlock(&storeLock);
+            session->isAdmin = userAt(session->user)->isAdmin;
+            snprintf(session->username, sizeof(session->username), "%s", userAt(session->user)->username);
+            pthread_rwlock_unlock(&storeLock);
+        }
+        break;
+    case COMMAND_LOGOUT:
+        session->user = -1;
+        *result = 0;
+        break;
+    case COMMAND_ADD_CAR:
+        if (isAdmin)
+            *result = doAddCar(f[1], f[2], atoi(f[3]), atof(f[4]), n > 5 ? f[5] : "");
+        break;
+    case COMMAND_DELETE_CAR:
+        if (isAdmin)
+            *result = doDeleteCar(atoi(f[1]));
+        break;
+    case COMMAND_RENT_CAR:
+        if (isCustomer)
+            *result = doRentCar(session->username, atoi(f[1]), n > 3 ? parseDay(f[3]) : today(), atoi(f[2]));
+        break;
+    case COMMAND_RETURN_CAR:
+        if (isCustomer)
+            *result = doReturnCar(session->username, atoi(f[1]));
+        break;
+    case COMMAND_IMPORT_CARS:
+        if (isAdmin)
+        {
+            int duplicates;
+            *result = doImportCars(f[1], &duplicates);
+        }
+        break;
+    case COMMAND_EXPORT_CARS:
+        if (isAdmin)
+            *result = doExportCars(f[1]);
+        break;
+    case COMMAND_TOP_CARS:
+    {
+        static __thread IntVec hits = {0};
+        int kind = topKindFind(f[1]);
+        if (kind != -1 && doTopCars(kind, atoi(f[2]), n > 3 ? f[3] : "", &hits) != -1)
+            *result = hits.count ? carAt(hits.items[0])->id : 0;
+        break;
+    }
+    }
+    return op;
+}
 
-        switch (choice)
+// --------------------------- Batch Mode ---------------------------
+// Blank lines and lines starting with '#' are skipped. Rejected commands
+// are counted, not fatal: a captured traffic log is expected to contain
+// failed logins and rentals. Returns -1 only if the file cannot be read.
+int runBatch(const char *path)
+{
+    FILE *fp = fopen(path, "r");
+    if (!fp)
+    {
+        printf("❌ Could not open %s!\n", path);
+        return -1;
+    }
+
+    long ok[COMMAND_COUNT] = {0}, failed[COMMAND_COUNT] = {0};
+    double seconds[COMMAND_COUNT] = {0};
+    Session session = {.user = -1};
+    char line[COMMAND_LINE_LENGTH];
+    int lineNo = 0;
+    long bad = 0;
+    double start = nowSeconds();
+
+    while (fgets(line, sizeof(line), fp))
+    {
+        lineNo++;
+        if (line[0] == '#' || line[strspn(line, " \t\r\n")] == '\0')
+            continue;
+
+        int result;
+        double t0 = nowSeconds();
+        int op = executeCommand(&session, line, &result);
+        if (op == -1)
         {
-        case 1:
-            listCars();
-            break;
-        case 2:
-            rentCar(username);
-            saveData();
-            break;
-        case 3:
-            returnCar();
-            saveData();
-            break;
-        case 4:
-            listRentals();
-            break;
-        case 5:
-            return;
-        default:
-            printf("Invalid choice!\n");
+            printf("❌ %s:%d: unknown command or missing fields: %s\n", path, lineNo, line);
+            bad++;
+            continue;
         }
-    } while (choice != 5);
+        seconds[op] += nowSeconds() - t0;
+        if (result == -1)
+            failed[op]++;
+        else
+            ok[op]++;
+    }
+    fclose(fp);
+
+    double total = nowSeconds() - start;
+    long totalFailed = bad;
+    printf("\n---------------------------------------------------------------------------------\n");
+    printf("Batch Report: %s\n", path);
+    printf("---------------------------------------------------------------------------------\n");
+    printf("%-12s %10s %10s %14s %14s\n", "Operation", "OK", "Failed", "ops/sec", "us/op");
+    printf("---------------------------------------------------------------------------------\n");
+    for (int op = 0; op < COMMAND_COUNT; op++)
+    {
+        long count = ok[op] + failed[op];
+        if (!count)
+            continue;
+        printf("%-12s %10ld %10ld %14.0f %14.2f\n", commands[op].name, ok[op], failed[op],
+               seconds[op] > 0 ? count / seconds[op] : 0.0, seconds[op] * 1e6 / count);
+        totalFailed += failed[op];
+    }
+    printf("---------------------------------------------------------------------------------\n");
+    printf("%d lines in %.3f s, %ld failed\n", lineNo, total, totalFailed);
+    return 0;
 }
 
-// --------------------------- Cars ---------------------------
-void addCar()
+// --------------------------- Server Mode ---------------------------
+// --serve PATH [WORKERS] listens on a Unix socket. Each connection is a
+// session speaking the command protocol above plus "quit"; every command
+// gets one reply line, "OK <result>" or "ERR <reason>". Accepted
+// connections wait in a bounded queue until one of the worker threads is
+// free, so the number of threads never depends on the number of clients.
+
+volatile sig_atomic_t serverRunning = 1;
+
+void serverStop(int sig)
+{
+    (void)sig;
+    serverRunning = 0;
+}
+
+void connQueuePush(int fd)
+{
+    pthread_mutex_lock(&connQueue.lock);
+    while (connQueue.count == SERVER_QUEUE_LENGTH)
+        pthread_cond_wait(&connQueue.notFull, &connQueue.lock);
+    connQueue.fds[(connQueue.head + connQueue.count++) % SERVER_QUEUE_LENGTH] = fd;
+    pthread_cond_signal(&connQueue.notEmpty);
+    pthread_mutex_unlock(&connQueue.lock);
+}
+
+int connQueuePop()
+{
+    pthread_mutex_lock(&connQueue.lock);
+    while (connQueue.count == 0)
+        pthread_cond_wait(&connQueue.notEmpty, &connQueue.lock);
+    int fd = connQueue.fds[connQueue.head];
+    connQueue.head = (connQueue.head + 1) % SERVER_QUEUE_LENGTH;
+    connQueue.count--;
+    pthread_cond_signal(&connQueue.notFull);
+    pthread_mutex_unlock(&connQueue.lock);
+    return fd;
+}
+
+void serveSession(int fd)
 {
-    if (carCount >= MAX_CARS)
+    FILE *in = fdopen(fd, "r");
+    FILE *out = fdopen(dup(fd), "w");
+    if (!in || !out)
     {
-        printf("❌ Car list full!\n");
+        if (in)
+            fclose(in);
+        else
+            close(fd);
+        if (out)
+            fclose(out);
         return;
     }
 
-    Car c;
-    c.id = carCount + 1;
+    Session session = {.user = -1};
+    char line[COMMAND_LINE_LENGTH];
+    while (fgets(line, sizeof(line), in))
+    {
+        if (strncmp(line, "quit", 4) == 0)
+            break;
 
-    printf("Enter Car Brand: ");
-    fgets(c.brand, sizeof(c.brand), stdin);
-    fix_gets_input(c.brand);
+        int result;
+        int op = executeCommand(&session, line, &result);
+        if (op == -1)
+            fprintf(out, "ERR unknown command\n");
+        else if (result == -1)
+            fprintf(out, "ERR %s rejected\n", commands[op].name);
+        else
+            fprintf(out, "OK %d\n", result);
+        if (fflush(out) != 0)
+            break;
+    }
+    fclose(in);
+    fclose(out);
+}
 
-    printf("Enter Car Model: ");
-    fgets(c.model, sizeof(c.model), stdin);
-    fix_gets_input(c.model);
+void *serverWorker(void *arg)
+{
+    (void)arg;
+    for (;;)
+        serveSession(connQueuePop());
+    return NULL;
+}
 
-     // Check for duplicate Brand+Model
-    for (int i = 0; i < carCount; i++)
+int runServer(const char *path, int workers)
+{
+    int listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    struct sockaddr_un addr = {0};
+    addr.sun_family = AF_UNIX;
+    if (listenFd < 0 || strlen(path) >= sizeof(addr.sun_path))
+    {
+        printf("❌ Could not create socket %s!\n", path);
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+    unlink(path);
+    if (bind(listenFd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(listenFd, SERVER_BACKLOG) != 0)
+    {
+        printf("❌ Could not listen on %s!\n", path);
+        close(listenFd);
+        return -1;
+    }
+
+    // No SA_RESTART, so accept() returns when a stop signal arrives
+    struct sigaction sa = {0};
+    sa.sa_handler = serverStop;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    for (int i = 0; i < workers; i++)
     {
-        if (strcmp(c.brand, cars[i].brand) == 0 && strcmp(c.model, cars[i].model) == 0)
+        pthread_t tid;
+        if (pthread_create(&tid, NULL, serverWorker, NULL) != 0)
         {
-            printf("❌ This car is already added!\n");
-            return;
+            printf("❌ Could not start worker threads!\n");
+            return -1;
         }
+        pthread_detach(tid);
     }
+    printf("✅ Serving on %s with %d workers (Ctrl+C to stop)\n", path, workers);
 
-    printf("Enter Year: ");
-    scanf("%d", &c.year);
-    while (getchar() != '\n');
+    while (serverRunning)
+    {
+        int fd = accept(listenFd, NULL, NULL);
+        if (fd >= 0)
+            connQueuePush(fd);
+    }
 
-    printf("Enter Price per Day: ");
-    scanf("%f", &c.pricePerDay);
-    while (getchar() != '\n');
+    close(listenFd);
+    unlink(path);
 
-    c.isAvailable = 1;
-    cars[carCount++] = c;
-    printf("✅ Car Added Successfully!\n");
+    // Sessions may still be running; block them out while saving.
+    // (The statistics take the read lock, so they go first.) storeLock is
+    // left write-locked on purpose: main() exits as soon as this returns,
+    // and a session still connected must not change data that has been
+    // saved. Nothing may take storeLock after this.
+    statsWrite();
+    sharedLock();
+    pthread_rwlock_wrlock(&storeLock);
+    archiveRentals();
+    sharedUnlock();
+    sharedClose();
+    printf("\nServer stopped.\n");
+    return 0;
+}
+
+// --------------------------- Benchmarks ---------------------------
+// --generate N writes users.txt, cars.txt and rentals.txt with N rentals,
+// N/10 cars and N/10 users (at least 10 of each) in the current directory.
+// --bench N generates the same data in a scratch directory under /tmp and
+// times the storage and index layers on it. Results are appended to a CSV
+// file, one row per benchmark:
+//   scale,benchmark,ops,ns_per_op,p50_ns,p99_ns,peak_rss_kb
+
+typedef struct
+{
+    double *samples;
+    int count;
+    int cap;
+} BenchTimer;
+
+unsigned int benchRandom()
+{
+    static unsigned int state = 88172645u;
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+void generateData(int scale)
+{
+    static const char *brands[] = {"Toyota", "Honda", "Suzuki", "Hyundai", "Tata", "Mahindra", "Kia", "BMW",
+                                   "Audi", "Mercedes-Benz", "Ford", "Skoda", "Volkswagen", "Renault", "Nissan",
+                                   "Mazda", "Jeep", "Volvo", "Lexus", "Porsche"};
+    int brandCount = sizeof(brands) / sizeof(brands[0]);
+    int users = scale / 10 > 10 ? scale / 10 : 10;
+    int cars = users;
+    FILE *fp;
+
+    // Passwords are hashed here, on the pool, so every import of the
+    // generated data does not pay for it again.
+    KdfJob *jobs = calloc(users, sizeof(KdfJob));
+    if (!jobs)
+    {
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < users; i++)
+        snprintf(jobs[i].password, sizeof(jobs[i].password), "pass%d", i);
+    kdfRun(jobs, users);
+
+    fp = fopen("users.txt", "w");
+    if (fp)
+    {
+        fprintf(fp, "%d\n", users);
+        for (int i = 0; i < users; i++)
+            fprintf(fp, "user%d,%s,%d\n", i, jobs[i].hash, i == 0);
+        fclose(fp);
+    }
+    free(jobs);
+
+    fp = fopen("cars.txt", "w");
+    if (fp)
+    {
+        fprintf(fp, "%d\n", cars);
+        for (int i = 0; i < cars; i++)
+            fprintf(fp, "%d,%s,Model-%d,%d,%d.00,%d,Branch-%d\n", i + 1, brands[benchRandom() % brandCount], i,
+                    2000 + benchRandom() % 26, 1000 + benchRandom() % 49000, benchRandom() % 4 != 0, i % BENCH_BRANCHES + 1);
+        fclose(fp);
+    }
+
+    fp = fopen("rentals.txt", "w");
+    if (fp)
+    {
+        fprintf(fp, "%d\n", scale);
+        int now = today();
+        for (int i = 0; i < scale; i++)
+        {
+            int days = 1 + benchRandom() % 14;
+            int start = now - 400 + (int)(benchRandom() % 380);
+            char from[11], to[11];
+            formatDay(start, from);
+            formatDay(start + days, to);
+            fprintf(fp, "%d,user%d,%d,%d,%d.00,1,%s,%s\n", i + 1, benchRandom() % users, 1 + benchRandom() % cars,
+                    days, days * (1000 + benchRandom() % 49000), from, to);
+        }
+        fclose(fp);
+    }
+}
+
+void benchRecord(BenchTimer *t, double seconds)
+{
+    if (t->count == t->cap)
+    {
+        t->cap = t->cap ? t->cap * 2 : 64;
+        t->samples = xrealloc(t->samples, t->cap * sizeof(double));
+    }
+    t->samples[t->count++] = seconds;
+}
+
+int compareDouble(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Print and write one result row, then reset the timer.
+void benchReport(FILE *out, int scale, const char *name, BenchTimer *t)
+{
+    if (!t->count)
+        return;
+
+    double total = 0;
+    for (int i = 0; i < t->count; i++)
+        total += t->samples[i];
+    qsort(t->samples, t->count, sizeof(double), compareDouble);
+    double p50 = t->samples[(t->count - 1) / 2];
+    double p99 = t->samples[(int)((t->count - 1) * 0.99)];
+
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+
+    printf("%-18s %10d %14.0f %14.0f %14.0f %14ld\n", name, t->count, total * 1e9 / t->count, p50 * 1e9, p99 * 1e9, ru.ru_maxrss);
+    fprintf(out, "%d,%s,%d,%.0f,%.0f,%.0f,%ld\n", scale, name, t->count, total * 1e9 / t->count, p50 * 1e9, p99 * 1e9, ru.ru_maxrss);
+    t->count = 0;
+}
+
+int runBenchmarks(int scale, const char *outPath)
+{
+    FILE *out = fopen(outPath, "a");
+    if (!out)
+    {
+        printf("❌ Could not open %s!\n", outPath);
+        return -1;
+    }
+    fseek(out, 0, SEEK_END);
+    if (ftell(out) == 0)
+        fprintf(out, "scale,benchmark,ops,ns_per_op,p50_ns,p99_ns,peak_rss_kb\n");
+
+    char dir[] = "/tmp/car_rental_bench.XXXXXX";
+    char cwd[4096];
+    if (!getcwd(cwd, sizeof(cwd)) || !mkdtemp(dir) || chdir(dir) != 0)
+    {
+        printf("❌ Could not create a scratch directory!\n");
+        fclose(out);
+        return -1;
+    }
+
+    static const char *indexNames[] = {"list_by_id", "list_by_brand", "list_by_model", "list_by_year", "list_by_price", "list_by_status"};
+    BenchTimer t = {0};
+    double t0;
+
+    printf("Benchmark scale %d (in %s)\n", scale, dir);
+    printf("%-18s %10s %14s %14s %14s %14s\n", "Benchmark", "Ops", "ns/op", "p50 ns", "p99 ns", "Peak RSS KB");
+
+    t0 = nowSeconds();
+    generateData(scale);
+    benchRecord(&t, nowSeconds() - t0);
+    benchReport(out, scale, "generate", &t);
+
+    t0 = nowSeconds();
+    loadData(); // no snapshot yet, so this parses the text files
+    benchRecord(&t, nowSeconds() - t0);
+    benchReport(out, scale, "load_text", &t);
+
+    for (int i = 0; i < 3; i++)
+    {
+        t0 = nowSeconds();
+        saveData();
+        benchRecord(&t, nowSeconds() - t0);
+    }
+    benchReport(out, scale, "save_snapshot", &t);
+
+    for (int i = 0; i < 3; i++)
+    {
+        t0 = nowSeconds();
+        loadData();
+        benchRecord(&t, nowSeconds() - t0);
+    }
+    benchReport(out, scale, "load_snapshot", &t);
+
+    t0 = nowSeconds();
+    exportText();
+    benchRecord(&t, nowSeconds() - t0);
+    benchReport(out, scale, "save_text", &t);
+
+    // Sorted listings: a full walk of each index, touching every car
+    for (int k = 0; k < CAR_INDEX_COUNT; k++)
+    {
+        for (int i = 0; i < 5; i++)
+        {
+            volatile float sink = 0;
+            t0 = nowSeconds();
+            for (SkipNode *n = carIndexes[k]->head->next[0].node; n; n = n->next[0].node)
+                sink += carAt(n->slot)->pricePerDay;
+            benchRecord(&t, nowSeconds() - t0);
+        }
+        benchReport(out, scale, indexNames[k], &t);
+    }
+
+    t0 = nowSeconds();
+    carIndexRebuild();
+    benchRecord(&t, nowSeconds() - t0);
+    benchReport(out, scale, "index_rebuild", &t);
+
+    for (int i = 0; i < BENCH_LOGINS; i++)
+    {
+        char username[CREDENTIAL_LENGTH], password[CREDENTIAL_LENGTH];
+        int u = benchRandom() % userTable.count;
+        snprintf(username, sizeof(username), "user%d", u);
+        snprintf(password, sizeof(password), "pass%d", u);
+        t0 = nowSeconds();
+        doLogin(username, password);
+        benchRecord(&t, nowSeconds() - t0);
+    }
+    benchReport(out, scale, "login", &t);
+
+    // Multi-criteria searches over the car columns
+    static const char *searchBrands[] = {"", "Toyota", "BMW", "Kia"};
+    IntVec hits = {0};
+    for (int i = 0; i < BENCH_SEARCHES; i++)
+    {
+        float low = 1000 + benchRandom() % 40000;
+        CarQuery q = {.brand = searchBrands[i % 4], .minPrice = low, .maxPrice = low + 10000, .minYear = 2000 + benchRandom() % 26, .availableOnly = 1};
+        t0 = nowSeconds();
+        doSearchCars(&q, &hits);
+        benchRecord(&t, nowSeconds() - t0);
+    }
+    benchReport(out, scale, "search", &t);
+
+    // The same searches at one branch, which scan only its shard
+    for (int i = 0; i < BENCH_SEARCHES; i++)
+    {
+        char branch[NAME_LENGTH];
+        snprintf(branch, sizeof(branch), "Branch-%d", i % BENCH_BRANCHES + 1);
+        float low = 1000 + benchRandom() % 40000;
+        CarQuery q = {.brand = searchBrands[i % 4], .minPrice = low, .maxPrice = low + 10000, .minYear = 2000 + benchRandom() % 26, .availableOnly = 1, .branch = branch};
+        t0 = nowSeconds();
+        doSearchCars(&q, &hits);
+        benchRecord(&t, nowSeconds() - t0);
+    }
+    benchReport(out, scale, "search_branch", &t);
+
+    // Cars free for the next week, over every branch
+    for (int i = 0; i < BENCH_SEARCHES / 10; i++)
+    {
+        t0 = nowSeconds();
+        doFreeCars(today(), today() + 7, "", &hits);
+        benchRecord(&t, nowSeconds() - t0);
+    }
+    benchReport(out, scale, "free_cars", &t);
+
+    // Top-K: cheapest and newest from the indexes, most rented and any
+    // kind at one branch through the heap
+    static const char *topNames[] = {"top_cheapest", "top_newest", "top_rented"};
+    for (int kind = TOP_CHEAPEST; kind <= TOP_MOST_RENTED; kind++)
+    {
+        for (int i = 0; i < BENCH_SEARCHES / 10; i++)
+        {
+            t0 = nowSeconds();
+            doTopCars(kind, BENCH_TOP_K, "", &hits);
+            benchRecord(&t, nowSeconds() - t0);
+        }
+        benchReport(out, scale, topNames[kind], &t);
+    }
+    for (int i = 0; i < BENCH_SEARCHES; i++)
+    {
+        char branch[NAME_LENGTH];
+        snprintf(branch, sizeof(branch), "Branch-%d", i % BENCH_BRANCHES + 1);
+        t0 = nowSeconds();
+        doTopCars(i % 3, BENCH_TOP_K, branch, &hits);
+        benchRecord(&t, nowSeconds() - t0);
+    }
+    benchReport(out, scale, "top_branch", &t);
+
+    // Name search: brand prefixes and typos, then model and customer names
+    // with a letter swapped
+    static const char *findBrands[] = {"toy", "Hond", "mercedes benz", "Volkswagon"};
+    for (int i = 0; i < BENCH_SEARCHES; i++)
+    {
+        t0 = nowSeconds();
+        doFindCars(findBrands[i % 4], &hits);
+        benchRecord(&t, nowSeconds() - t0);
+    }
+    benchReport(out, scale, "find_brand", &t);
+    for (int i = 0; i < BENCH_SEARCHES; i++)
+    {
+        char model[NAME_LENGTH];
+        snprintf(model, sizeof(model), "Modle-%d", (int)(benchRandom() % (nextCarId - 1)));
+        t0 = nowSeconds();
+        doFindCars(model, &hits);
+        benchRecord(&t, nowSeconds() - t0);
+    }
+    benchReport(out, scale, "find_model", &t);
+    for (int i = 0; i < BENCH_SEARCHES; i++)
+    {
+        char name[CUSTOMER_NAME_LENGTH];
+        snprintf(name, sizeof(name), "usre%d", (int)(benchRandom() % userTable.count));
+        t0 = nowSeconds();
+        doFindCustomers(name, &hits);
+        benchRecord(&t, nowSeconds() - t0);
+    }
+    free(hits.items);
+    benchReport(out, scale, "find_customer", &t);
+
+    // Rent and return go through the journal, checkpoints included
+    journalOpen();
+    for (int i = 0; i < BENCH_RENT_CYCLES; i++)
+    {
+        int carId = 1 + benchRandom() % (nextCarId - 1);
+        t0 = nowSeconds();
+        int rentalId = doRentCar("user1", carId, today(), 3);
+        if (rentalId != -1)
+            doReturnCar("user1", rentalId);
+        benchRecord(&t, nowSeconds() - t0);
+    }
+    benchReport(out, scale, "rent_return", &t);
+
+    journalClose();
+    fclose(out);
+    free(t.samples);
+
+    remove("users.txt");
+    remove("cars.txt");
+    remove("rentals.txt");
+    remove(SNAPSHOT_FILE);
+    remove(JOURNAL_FILE);
+    char path[64];
+    for (int segment = 0;; segment++)
+    {
+        snprintf(path, sizeof(path), HISTORY_FILE_FORMAT, segment);
+        if (remove(path) != 0)
+            break;
+    }
+    if (chdir(cwd) != 0 || rmdir(dir) != 0)
+        printf("❌ Could not remove %s!\n", dir);
+    printf("✅ Results appended to %s\n", outPath);
+    return 0;
+}
+
+// --------------------------- Password Hashing ---------------------------
+// Passwords are stored as "$scrypt$log2N$r$p$salt$hash" (salt and hash in
+// hex). scrypt is built here from SHA-256 so the program keeps no external
+// dependencies; it matches the RFC 7914 test vectors.
+
+static const unsigned int sha256K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+#define ROTR32(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+#define ROTL32(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+
+void sha256Block(Sha256 *ctx, const unsigned char *block)
+{
+    unsigned int w[64];
+    for (int i = 0; i < 16; i++)
+        w[i] = (unsigned int)block[i * 4] << 24 | (unsigned int)block[i * 4 + 1] << 16 |
+               (unsigned int)block[i * 4 + 2] << 8 | block[i * 4 + 3];
+    for (int i = 16; i < 64; i++)
+    {
+        unsigned int s0 = ROTR32(w[i - 15], 7) ^ ROTR32(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        unsigned int s1 = ROTR32(w[i - 2], 17) ^ ROTR32(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    unsigned int a = ctx->state[0], b = ctx->state[1], c = ctx->state[2], d = ctx->state[3];
+    unsigned int e = ctx->state[4], f = ctx->state[5], g = ctx->state[6], h = ctx->state[7];
+    for (int i = 0; i < 64; i++)
+    {
+        unsigned int t1 = h + (ROTR32(e, 6) ^ ROTR32(e, 11) ^ ROTR32(e, 25)) + ((e & f) ^ (~e & g)) + sha256K[i] + w[i];
+        unsigned int t2 = (ROTR32(a, 2) ^ ROTR32(a, 13) ^ ROTR32(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+    ctx->state[0] += a;
+    ctx->state[1] += b;
+    ctx->state[2] += c;
+    ctx->state[3] += d;
+    ctx->state[4] += e;
+    ctx->state[5] += f;
+    ctx->state[6] += g;
+    ctx->state[7] += h;
+}
+
+void sha256Init(Sha256 *ctx)
+{
+    static const unsigned int iv[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                                       0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+    memcpy(ctx->state, iv, sizeof(iv));
+    ctx->length = 0;
+    ctx->fill = 0;
+}
+
+void sha256Update(Sha256 *ctx, const void *data, size_t len)
+{
+    const unsigned char *p = data;
+    ctx->length += len;
+    while (len > 0)
+    {
+        size_t n = 64 - ctx->fill < len ? 64 - ctx->fill : len;
+        memcpy(ctx->buffer + ctx->fill, p, n);
+        ctx->fill += n;
+        p += n;
+        len -= n;
+        if (ctx->fill == 64)
+        {
+            sha256Block(ctx, ctx->buffer);
+            ctx->fill = 0;
+        }
+    }
+}
+
+void sha256Final(Sha256 *ctx, unsigned char *digest)
+{
+    unsigned long long bits = ctx->length * 8;
+    unsigned char pad = 0x80;
+    sha256Update(ctx, &pad, 1);
+    pad = 0;
+    while (ctx->fill != 56)
+        sha256Update(ctx, &pad, 1);
+    unsigned char lengthBytes[8];
+    for (int i = 0; i < 8; i++)
+        lengthBytes[i] = (unsigned char)(bits >> (56 - 8 * i));
+    sha256Update(ctx, lengthBytes, 8);
+    for (int i = 0; i < 8; i++)
+    {
+        digest[i * 4] = (unsigned char)(ctx->state[i] >> 24);
+        digest[i * 4 + 1] = (unsigned char)(ctx->state[i] >> 16);
+        digest[i * 4 + 2] = (unsigned char)(ctx->state[i] >> 8);
+        digest[i * 4 + 3] = (unsigned char)ctx->state[i];
+    }
+}
+
+// PBKDF2-HMAC-SHA256 with the key schedule computed once for all blocks.
+void pbkdf2Sha256(const void *key, size_t keyLen, const void *salt, size_t saltLen,
+                  unsigned int iterations, unsigned char *out, size_t outLen)
+{
+    unsigned char k[64] = {0}, pad[64];
+    if (keyLen > 64)
+    {
+        Sha256 t;
+        sha256Init(&t);
+        sha256Update(&t, key, keyLen);
+        sha256Final(&t, k);
+    }
+    else
+        memcpy(k, key, keyLen);
+
+    Sha256 inner, outer;
+    for (int i = 0; i < 64; i++)
+        pad[i] = k[i] ^ 0x36;
+    sha256Init(&inner);
+    sha256Update(&inner, pad, 64);
+    for (int i = 0; i < 64; i++)
+        pad[i] = k[i] ^ 0x5c;
+    sha256Init(&outer);
+    sha256Update(&outer, pad, 64);
+
+    for (unsigned int block = 1; outLen > 0; block++)
+    {
+        unsigned char counter[4] = {block >> 24, block >> 16, block >> 8, block};
+        unsigned char u[32], t[32];
+        Sha256 ctx = inner;
+        sha256Update(&ctx, salt, saltLen);
+        sha256Update(&ctx, counter, 4);
+        sha256Final(&ctx, u);
+        ctx = outer;
+        sha256Update(&ctx, u, 32);
+        sha256Final(&ctx, u);
+        memcpy(t, u, 32);
+        for (unsigned int i = 1; i < iterations; i++)
+        {
+            ctx = inner;
+            sha256Update(&ctx, u, 32);
+            sha256Final(&ctx, u);
+            ctx = outer;
+            sha256Update(&ctx, u, 32);
+            sha256Final(&ctx, u);
+            for (int j = 0; j < 32; j++)
+                t[j] ^= u[j];
+        }
+        size_t n = outLen < 32 ? outLen : 32;
+        memcpy(out, t, n);
+        out += n;
+        outLen -= n;
+    }
+}
+
+void salsa208(unsigned int b[16])
+{
+    unsigned int x[16];
+    memcpy(x, b, sizeof(x));
+    for (int i = 0; i < 8; i += 2)
+    {
+        x[4] ^= ROTL32(x[0] + x[12], 7);   x[8] ^= ROTL32(x[4] + x[0], 9);
+        x[12] ^= ROTL32(x[8] + x[4], 13);  x[0] ^= ROTL32(x[12] + x[8], 18);
+        x[9] ^= ROTL32(x[5] + x[1], 7);    x[13] ^= ROTL32(x[9] + x[5], 9);
+        x[1] ^= ROTL32(x[13] + x[9], 13);  x[5] ^= ROTL32(x[1] + x[13], 18);
+        x[14] ^= ROTL32(x[10] + x[6], 7);  x[2] ^= ROTL32(x[14] + x[10], 9);
+        x[6] ^= ROTL32(x[2] + x[14], 13);  x[10] ^= ROTL32(x[6] + x[2], 18);
+        x[3] ^= ROTL32(x[15] + x[11], 7);  x[7] ^= ROTL32(x[3] + x[15], 9);
+        x[11] ^= ROTL32(x[7] + x[3], 13);  x[15] ^= ROTL32(x[11] + x[7], 18);
+        x[1] ^= ROTL32(x[0] + x[3], 7);    x[2] ^= ROTL32(x[1] + x[0], 9);
+        x[3] ^= ROTL32(x[2] + x[1], 13);   x[0] ^= ROTL32(x[3] + x[2], 18);
+        x[6] ^= ROTL32(x[5] + x[4], 7);    x[7] ^= ROTL32(x[6] + x[5], 9);
+        x[4] ^= ROTL32(x[7] + x[6], 13);   x[5] ^= ROTL32(x[4] + x[7], 18);
+        x[11] ^= ROTL32(x[10] + x[9], 7);  x[8] ^= ROTL32(x[11] + x[10], 9);
+        x[9] ^= ROTL32(x[8] + x[11], 13);  x[10] ^= ROTL32(x[9] + x[8], 18);
+        x[12] ^= ROTL32(x[15] + x[14], 7); x[13] ^= ROTL32(x[12] + x[15], 9);
+        x[14] ^= ROTL32(x[13] + x[12], 13); x[15] ^= ROTL32(x[14] + x[13], 18);
+    }
+    for (int i = 0; i < 16; i++)
+        b[i] += x[i];
+}
+
+// scryptBlockMix over 2 * r 64-byte blocks; y is scratch of the same size.
+void scryptBlockMix(unsigned int *b, unsigned int *y, int r)
+{
+    unsigned int x[16];
+    memcpy(x, &b[(2 * r - 1) * 16], 64);
+    for (int i = 0; i < 2 * r; i++)
+    {
+        for (int j = 0; j < 16; j++)
+            x[j] ^= b[i * 16 + j];
+        salsa208(x);
+        // Even blocks go to the first half of the output, odd to the second
+        memcpy(&y[((i & 1) * r + i / 2) * 16], x, 64);
+    }
+    memcpy(b, y, 128 * r);
+}
+
+// scryptROMix on one 128 * r byte block, using v (128 * r * n bytes).
+void scryptROMix(unsigned char *block, int r, unsigned long n, unsigned int *v, unsigned int *x, unsigned int *y)
+{
+    size_t words = 32 * r;
+    for (size_t k = 0; k < words; k++)
+        x[k] = (unsigned int)block[k * 4] | (unsigned int)block[k * 4 + 1] << 8 |
+               (unsigned int)block[k * 4 + 2] << 16 | (unsigned int)block[k * 4 + 3] << 24;
+    for (unsigned long i = 0; i < n; i++)
+    {
+        memcpy(&v[i * words], x, words * 4);
+        scryptBlockMix(x, y, r);
+    }
+    for (unsigned long i = 0; i < n; i++)
+    {
+        unsigned long j = x[(2 * r - 1) * 16] & (n - 1);
+        for (size_t k = 0; k < words; k++)
+            x[k] ^= v[j * words + k];
+        scryptBlockMix(x, y, r);
+    }
+    for (size_t k = 0; k < words; k++)
+    {
+        block[k * 4] = (unsigned char)x[k];
+        block[k * 4 + 1] = (unsigned char)(x[k] >> 8);
+        block[k * 4 + 2] = (unsigned char)(x[k] >> 16);
+        block[k * 4 + 3] = (unsigned char)(x[k] >> 24);
+    }
+}
+
+// Returns -1 if the parameters are out of range or memory runs out.
+int scrypt(const char *password, const unsigned char *salt, size_t saltLen,
+           int log2N, int r, int p, unsigned char *out, size_t outLen)
+{
+    if (log2N < 1 || log2N > KDF_MAX_LOG2N || r < 1 || r > 32 || p < 1 || p > 16)
+        return -1;
+
+    unsigned long n = 1UL << log2N;
+    unsigned char *b = malloc((size_t)128 * r * p);
+    unsigned int *v = malloc((size_t)128 * r * n);
+    unsigned int *xy = malloc((size_t)256 * r);
+    int result = -1;
+    if (b && v && xy)
+    {
+        size_t len = strlen(password);
+        pbkdf2Sha256(password, len, salt, saltLen, 1, b, (size_t)128 * r * p);
+        for (int i = 0; i < p; i++)
+            scryptROMix(b + (size_t)128 * r * i, r, n, v, xy, xy + 32 * r);
+        pbkdf2Sha256(password, len, b, (size_t)128 * r * p, 1, out, outLen);
+        result = 0;
+    }
+    free(b);
+    free(v);
+    free(xy);
+    return result;
+}
+
+void hexEncode(const unsigned char *in, size_t len, char *out)
+{
+    static const char digits[] = "0123456789abcdef";
+    for (size_t i = 0; i < len; i++)
+    {
+        out[i * 2] = digits[in[i] >> 4];
+        out[i * 2 + 1] = digits[in[i] & 15];
+    }
+    out[len * 2] = '\0';
+}
+
+int hexDecode(const char *in, unsigned char *out, size_t len)
+{
+    for (size_t i = 0; i < len; i++)
+    {
+        unsigned int byte;
+        if (sscanf(in + i * 2, "%2x", &byte) != 1)
+            return -1;
+        out[i] = (unsigned char)byte;
+    }
+    return 0;
+}
+
+// Compare without an early exit so the time taken says nothing about where
+// the first difference is.
+int constantTimeEqual(const unsigned char *a, const unsigned char *b, size_t len)
+{
+    unsigned char diff = 0;
+    for (size_t i = 0; i < len; i++)
+        diff |= a[i] ^ b[i];
+    return diff == 0;
+}
+
+int isPasswordHash(const char *stored)
+{
+    return strncmp(stored, KDF_PREFIX, strlen(KDF_PREFIX)) == 0;
+}
+
+// Hash password with a fresh salt and the current work factor into out
+// (PASSWORD_HASH_LENGTH bytes).
+int passwordHash(const char *password, char *out)
+{
+    unsigned char salt[KDF_SALT_LENGTH], hash[KDF_HASH_LENGTH];
+    if (getrandom(salt, sizeof(salt), 0) != (ssize_t)sizeof(salt))
+        return -1;
+    if (scrypt(password, salt, sizeof(salt), kdfLog2N, KDF_R, KDF_P, hash, sizeof(hash)) != 0)
+        return -1;
+
+    char saltHex[KDF_SALT_LENGTH * 2 + 1], hashHex[KDF_HASH_LENGTH * 2 + 1];
+    hexEncode(salt, sizeof(salt), saltHex);
+    hexEncode(hash, sizeof(hash), hashHex);
+    snprintf(out, PASSWORD_HASH_LENGTH, KDF_PREFIX "%d$%d$%d$%s$%s", kdfLog2N, KDF_R, KDF_P, saltHex, hashHex);
+    return 0;
+}
+
+// Returns 1 if password matches the stored hash. The work factor comes from
+// the stored string, so hashes made with an older setting keep working.
+int passwordVerify(const char *password, const char *stored)
+{
+    int log2N, r, p, used = 0;
+    char saltHex[KDF_SALT_LENGTH * 2 + 1], hashHex[KDF_HASH_LENGTH * 2 + 1];
+    if (sscanf(stored, KDF_PREFIX "%d$%d$%d$%32[0-9a-f]$%64[0-9a-f]%n", &log2N, &r, &p, saltHex, hashHex, &used) != 5 ||
+        stored[used] != '\0' || strlen(saltHex) != KDF_SALT_LENGTH * 2 || strlen(hashHex) != KDF_HASH_LENGTH * 2)
+        return 0;
+
+    unsigned char salt[KDF_SALT_LENGTH], expected[KDF_HASH_LENGTH], actual[KDF_HASH_LENGTH];
+    if (hexDecode(saltHex, salt, sizeof(salt)) != 0 || hexDecode(hashHex, expected, sizeof(expected)) != 0)
+        return 0;
+    if (scrypt(password, salt, sizeof(salt), log2N, r, p, actual, sizeof(actual)) != 0)
+        return 0;
+    return constantTimeEqual(expected, actual, sizeof(actual));
+}
+
+// The pool bounds how many derivations run at once (and so how much memory
+// they hold). Callers queue a job and sleep until a worker finishes it, so
+// a slow hash never holds a store lock or a server worker's CPU.
+void *kdfWorker(void *arg)
+{
+    (void)arg;
+    for (;;)
+    {
+        pthread_mutex_lock(&kdfLock);
+        while (!kdfQueue)
+            pthread_cond_wait(&kdfQueued, &kdfLock);
+        KdfJob *job = kdfQueue;
+        kdfQueue = job->next;
+        if (!kdfQueue)
+            kdfQueueTail = NULL;
+        pthread_mutex_unlock(&kdfLock);
+
+        if (job->verify)
+            job->result = passwordVerify(job->password, job->hash);
+        else
+            job->result = passwordHash(job->password, job->hash);
+
+        pthread_mutex_lock(&kdfLock);
+        job->done = 1;
+        pthread_cond_broadcast(&kdfDone);
+        pthread_mutex_unlock(&kdfLock);
+    }
+    return NULL;
+}
+
+void kdfStartWorkers()
+{
+    int workers = kdfWorkers > 0 ? kdfWorkers : (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (workers < 1)
+        workers = 1;
+    for (int i = 0; i < workers; i++)
+    {
+        pthread_t tid;
+        if (pthread_create(&tid, NULL, kdfWorker, NULL) != 0)
+        {
+            if (i == 0)
+            {
+                perror("pthread_create");
+                exit(EXIT_FAILURE);
+            }
+            break;
+        }
+        pthread_detach(tid);
+    }
+}
+
+// Run count jobs on the pool and wait for all of them.
+void kdfRun(KdfJob *jobs, int count)
+{
+    static pthread_once_t started = PTHREAD_ONCE_INIT;
+    pthread_once(&started, kdfStartWorkers);
+
+    pthread_mutex_lock(&kdfLock);
+    for (int i = 0; i < count; i++)
+    {
+        jobs[i].done = 0;
+        jobs[i].next = NULL;
+        if (kdfQueueTail)
+            kdfQueueTail->next = &jobs[i];
+        else
+            kdfQueue = &jobs[i];
+        kdfQueueTail = &jobs[i];
+    }
+    pthread_cond_broadcast(&kdfQueued);
+    for (int i = 0; i < count; i++)
+        while (!jobs[i].done)
+            pthread_cond_wait(&kdfDone, &kdfLock);
+    pthread_mutex_unlock(&kdfLock);
+}
+
+// Hash every user whose password is still plaintext (imported from text
+// files written before hashing existed). Returns how many were hashed.
+int migratePasswords()
+{
+    IntVec pending = {0};
+    for (int i = 0; i < userTable.count; i++)
+        if (!isPasswordHash(userAt(i)->password))
+            intVecPush(&pending, i);
+    if (pending.count == 0)
+        return 0;
+
+    KdfJob *jobs = calloc(pending.count, sizeof(KdfJob));
+    if (!jobs)
+    {
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
+    for (int k = 0; k < pending.count; k++)
+    {
+        User *u = userAt(pending.items[k]);
+        snprintf(jobs[k].password, sizeof(jobs[k].password), "%s", u->password);
+    }
+    kdfRun(jobs, pending.count);
+    int count = 0;
+    for (int k = 0; k < pending.count; k++)
+    {
+        User *u = userAt(pending.items[k]);
+        if (jobs[k].result == 0)
+        {
+            memcpy(u->password, jobs[k].hash, sizeof(u->password));
+            count++;
+        }
+        else
+            printf("❌ Could not hash the password of %s.\n", u->username);
+    }
+    printf("✅ Hashed %d plaintext password(s)", count);
+    if (count < pending.count)
+        printf(", %d left as they were", pending.count - count);
+    printf(".\n");
+    free(jobs);
+    free(pending.items);
+    return count;
+}
+
+// --------------------------- Authentication ---------------------------
+
+void register_user()
+{
+    char username[CREDENTIAL_LENGTH], password[CREDENTIAL_LENGTH];
+    input_credentials(username, password);
+
+    // Check for duplicate username
+    if (findUserIndex(username) != -1)
+    {
+        printf("❌ Username already exists! Try another.\n");
+        return;
+    }
+
+    int isAdmin = 0;
+    int choice;
+    printf("Do you want to register as Admin? (1=Yes, 0=No): ");
+    if (scanf("%d", &choice) != 1)
+        choice = 0;
+    while (getchar() != '\n')
+        ;
+
+    if (choice == 1)
+    {
+        char adminKey[50];
+        printf("Enter Admin Authentication Key: ");
+        fgets(adminKey, sizeof(adminKey), stdin);
+        fix_gets_input(adminKey);
+
+        if (strcmp(adminKey, ADMIN_KEY) == 0)
+            isAdmin = 1;
+        else
+            printf("\n❌ Invalid key! Registering as Customer.\n");
+    }
+
+    if (doRegister(username, password, isAdmin) == -1)
+    {
+        printf("\n❌ Registration failed! The username must be new, not empty and without commas.\n");
+        return;
+    }
+    printf(isAdmin ? "\n✅ Admin registration successful!\n" : "\n✅ Registered as Customer.\n");
+    printf("\n✅ Registration Completed!\n");
+}
+
+int login_user()
+{
+    char username[CREDENTIAL_LENGTH];
+    char password[CREDENTIAL_LENGTH];
+
+    input_credentials(username, password);
+    return doLogin(username, password);
+}
+
+void input_credentials(char *username, char *password)
+{
+    printf("\nEnter username: ");
+    fgets(username, CREDENTIAL_LENGTH, stdin);
+    fix_gets_input(username);
+
+    printf("Enter password: ");
+    fflush(stdout);
+
+    struct termios old_props, new_props;
+    tcgetattr(STDIN_FILENO, &old_props);
+    new_props = old_props;
+    new_props.c_lflag &= ~(ECHO | ICANON);
+    tcsetattr(STDIN_FILENO, TCSANOW, &new_props);
+
+    char ch;
+    int i = 0;
+    while ((ch = getchar()) != '\n' && ch != EOF && i < CREDENTIAL_LENGTH - 1)
+    {
+        if (ch == '\b' || ch == 127)
+        {
+            if (i > 0)
+                i--;
+            printf("\b \b");
+        }
+        else
+        {
+            password[i++] = ch;
+            printf("*");
+        }
+    }
+    password[i] = '\0';
+    tcsetattr(STDIN_FILENO, TCSANOW, &old_props);
+    printf("\n");
+}
+
+void fix_gets_input(char *s)
+{
+    int pos = strcspn(s, "\n");
+    s[pos] = '\0';
+}
+
+// --------------------------- Menus ---------------------------
+void mainMenu(int userIndex)
+{
+    if (userAt(userIndex)->isAdmin)
+    {
+         printf("\n---------------------------------------------------------------------------------\n");
+        printf("Admin Menu\n");
+        printf("---------------------------------------------------------------------------------\n");
+        adminMenu();
+
+    }
+    else
+    {
+        printf("\n---------------------------------------------------------------------------------\n");
+        printf("Customer Menu\n");
+        printf("---------------------------------------------------------------------------------\n");
+        customerMenu(userAt(userIndex)->username);
+
+    }
+}
+
+void adminMenu()
+{
+    int choice;
+    do
+    {
+        printf("\nAdmin Menu\n");
+        printf("1. Add Car\n2. List Cars\n3. Delete Car\n4. List Rentals\n5. Revenue Report\n6. Statistics\n7. Export Data to Text Files\n");
+        printf("8. Import Cars from CSV\n9. Export Cars to CSV\n10. Find Customers\n11. Back to Main Menu\n");
+        printf("Enter choice: ");
+        if (scanf("%d", &choice) != 1)
+            choice = 11;
+        while (getchar() != '\n')
+            ;
+        sharedSync(); // pick up other instances' changes before showing data
+
+        switch (choice)
+        {
+        case 1:
+            addCar();
+            break;
+        case 2:
+            listCars();
+            break;
+        case 3:
+            deleteCar();
+            break;
+        case 4:
+            listRentals();
+            break;
+        case 5:
+            revenueReport();
+            break;
+        case 6:
+            statsScreen();
+            break;
+        case 7:
+            exportText();
+            printf("✅ Data exported to users.txt, cars.txt and rentals.txt!\n");
+            break;
+        case 8:
+            importCars();
+            break;
+        case 9:
+            exportCars();
+            break;
+        case 10:
+            findCustomers();
+            break;
+        case 11:
+            return;
+        default:
+            printf("Invalid choice!\n");
+        }
+    } while (choice != 11);
+}
+
+void customerMenu(const char *username)
+{
+    int choice;
+    do
+    {
+        printf("\nCustomer Menu\n");
+        printf("1. List Cars\n2. Rent Car\n3. Return Car\n4. My Rentals\n5. Search Cars\n6. Check Availability\n7. Top Picks\n8. Find Cars by Name\n9. Back to Main Menu\n");
+        printf("Enter choice: ");
+        if (scanf("%d", &choice) != 1)
+            choice = 9;
+        while (getchar() != '\n')
+            ;
+        sharedSync();
+
+        switch (choice)
+        {
+        case 1:
+            listCars();
+            break;
+        case 2:
+            rentCar(username);
+            break;
+        case 3:
+            returnCar(username);
+            break;
+        case 4:
+            listMyRentals(username);
+            break;
+        case 5:
+            searchCars();
+            break;
+        case 6:
+            checkAvailability();
+            break;
+        case 7:
+            topCars();
+            break;
+        case 8:
+            findCars();
+            break;
+        case 9:
+            return;
+        default:
+            printf("Invalid choice!\n");
+        }
+    } while (choice != 9);
+}
+
+// --------------------------- Lookups ---------------------------
+// FNV-1a
+unsigned int hashString(const char *s)
+{
+    unsigned int h = 2166136261u;
+    while (*s)
+        h = (h ^ (unsigned char)*s++) * 16777619u;
+    return h;
+}
+
+void userHashInsert(int index)
+{
+    // Keep the load factor at or below one half
+    if ((userTable.count + 1) * 2 > userHashCap)
+    {
+        userHashRebuild();
+        return;
+    }
+
+    unsigned int mask = userHashCap - 1;
+    unsigned int slot = hashString(userAt(index)->username) & mask;
+    while (userHashSlots[slot])
+        slot = (slot + 1) & mask;
+    userHashSlots[slot] = index + 1;
+}
+
+void userHashRebuild()
+{
+    int cap = 16;
+    while (cap < (userTable.count + 1) * 2)
+        cap *= 2;
+
+    free(userHashSlots);
+    userHashSlots = xrealloc(NULL, cap * sizeof(int));
+    memset(userHashSlots, 0, cap * sizeof(int));
+    userHashCap = cap;
+
+    for (int i = 0; i < userTable.count; i++)
+    {
+        unsigned int slot = hashString(userAt(i)->username) & (cap - 1);
+        while (userHashSlots[slot])
+            slot = (slot + 1) & (cap - 1);
+        userHashSlots[slot] = i + 1;
+    }
+}
+
+int findUserIndex(const char *username)
+{
+    if (!userHashCap)
+        return -1;
+
+    unsigned int mask = userHashCap - 1;
+    unsigned int slot = hashString(username) & mask;
+    while (userHashSlots[slot])
+    {
+        int i = userHashSlots[slot] - 1;
+        if (strcmp(username, userAt(i)->username) == 0)
+            return i;
+        slot = (slot + 1) & mask;
+    }
+    return -1;
+}
+
+int findCarIndex(int id)
+{
+    return idMapGet(&carSlotById, id);
+}
+
+int findRentalIndex(int rentalId)
+{
+    return idMapGet(&rentalSlotById, rentalId);
+}
+
+int findCarByName(const char *brand, const char *model)
+{
+    int brandId = dictFind(&brandDict, brand), modelId = dictFind(&modelDict, model);
+    if (brandId == -1 || modelId == -1)
+        return -1;
+    return carNameFind(brandId, modelId);
+}
+
+unsigned int carNameHash(int brand, int model)
+{
+    unsigned int h = (unsigned int)brand * 0x9e3779b1u ^ (unsigned int)model * 0x85ebca77u;
+    return h ^ (h >> 15);
+}
+
+int carNameFind(int brand, int model)
+{
+    if (!carNameCap)
+        return -1;
+    unsigned int mask = carNameCap - 1;
+    for (unsigned int i = carNameHash(brand, model) & mask; carNameSlots[i]; i = (i + 1) & mask)
+    {
+        const Car *c = carAt(carNameSlots[i] - 1);
+        if (c->brand == brand && c->model == model)
+            return carNameSlots[i] - 1;
+    }
+    return -1;
+}
+
+void carNameAdd(int slot)
+{
+    if ((carNameCount + 1) * 2 > carNameCap)
+    {
+        int *old = carNameSlots, oldCap = carNameCap;
+        carNameCap = carNameCap ? carNameCap * 2 : 64;
+        carNameSlots = xrealloc(NULL, carNameCap * sizeof(int));
+        memset(carNameSlots, 0, carNameCap * sizeof(int));
+        carNameCount = 0;
+        for (int i = 0; i < oldCap; i++)
+            if (old[i])
+                carNameAdd(old[i] - 1);
+        free(old);
+    }
+    unsigned int mask = carNameCap - 1;
+    unsigned int i = carNameHash(carAt(slot)->brand, carAt(slot)->model) & mask;
+    while (carNameSlots[i])
+        i = (i + 1) & mask;
+    carNameSlots[i] = slot + 1;
+    carNameCount++;
+}
+
+// Called before the slot is cleared. Later entries of the probe run are
+// shifted back over the hole, so no tombstones are needed.
+void carNameRemove(int slot)
+{
+    unsigned int mask = carNameCap - 1;
+    unsigned int i = carNameHash(carAt(slot)->brand, carAt(slot)->model) & mask;
+    while (carNameSlots[i] != slot + 1)
+        i = (i + 1) & mask;
+    for (unsigned int j = (i + 1) & mask; carNameSlots[j]; j = (j + 1) & mask)
+    {
+        const Car *c = carAt(carNameSlots[j] - 1);
+        unsigned int home = carNameHash(c->brand, c->model) & mask;
+        if (((j - home) & mask) >= ((j - i) & mask))
+        {
+            carNameSlots[i] = carNameSlots[j];
+            i = j;
+        }
+    }
+    carNameSlots[i] = 0;
+    carNameCount--;
+}
+
+void carNameRebuild()
+{
+    if (carNameCap)
+        memset(carNameSlots, 0, carNameCap * sizeof(int));
+    carNameCount = 0;
+    for (int i = 0; i < carTable.count; i++)
+        if (carAt(i)->id)
+            carNameAdd(i);
+}
+
+// Reuse a tombstoned slot if there is one, otherwise grow the table.
+int allocCarSlot()
+{
+    if (freeCarSlots.count > 0)
+        return freeCarSlots.items[--freeCarSlots.count];
+    tableAppend(&carTable);
+    return carTable.count - 1;
+}
+
+// Store a new car and register it with the id map and sorted indexes.
+int insertCar(const Car *c)
+{
+    int slot = allocCarSlot();
+    *carAt(slot) = *c;
+    idMapSet(&carSlotById, c->id, slot);
+    carIndexAdd(slot);
+    carBookings(slot); // create its entry while the write lock is held
+    statsCarAdded(slot);
+    return slot;
+}
+
+// isAvailable is a sort key, so it has to change through here.
+void setCarAvailable(int index, int available)
+{
+    if (carAt(index)->isAvailable == available)
+        return;
+    skipRemove(&carsByStatus, index);
+    carAt(index)->isAvailable = available;
+    skipInsert(&carsByStatus, index);
+    shardUpdate(index);
+    statsCarRented(index, available ? -1 : 1);
+}
+
+void removeCarAt(int index)
+{
+    statsCarRemoved(index);
+    carIndexRemove(index);
+    idMapSet(&carSlotById, carAt(index)->id, -1);
+    memset(carAt(index), 0, sizeof(Car));
+    intVecPush(&freeCarSlots, index);
+}
+
+// Recompute the car id map and free list from the table, for data that
+// came without them (text import).
+void rebuildCarIndexes()
+{
+    intVecResize(&carSlotById, 0);
+    intVecResize(&freeCarSlots, 0);
+    for (int i = 0; i < carTable.count; i++)
+    {
+        if (carAt(i)->id)
+            idMapSet(&carSlotById, carAt(i)->id, i);
+        else
+            intVecPush(&freeCarSlots, i);
+    }
+}
+
+int liveCarCount()
+{
+    return carTable.count - freeCarSlots.count;
+}
+
+// The user's entry in the per-customer rental index, created on demand.
+IntVec *customerRentals(int user)
+{
+    while (customerRentalTable.count <= user)
+        tableAppend(&customerRentalTable);
+    return (IntVec *)tableAt(&customerRentalTable, user);
+}
+
+void customerRentalAdd(int slot)
+{
+    int user = findUserIndex(rentalCustomer(rentalAt(slot)));
+    if (user != -1)
+        intVecPush(customerRentals(user), slot);
+}
+
+void customerRentalsRebuild()
+{
+    for (int i = 0; i < customerRentalTable.count; i++)
+        ((IntVec *)tableAt(&customerRentalTable, i))->count = 0;
+    for (int i = 0; i < rentalTable.count; i++)
+        customerRentalAdd(i);
+}
+
+// Data from before returns were recorded: a rental is still open only if
+// it is the newest rental of a car that is currently rented out. Returns
+// how many rentals were settled.
+int resolveRentalStatus()
+{
+    IntVec newest = {0}; // car id -> slot of its newest rental
+    int unknown = 0;
+    for (int i = 0; i < rentalTable.count; i++)
+    {
+        const Rental *r = rentalAt(i);
+        unknown += r->isReturned == -1;
+        int prev = idMapGet(&newest, r->carId);
+        if (r->carId > 0 && (prev == -1 || rentalAt(prev)->rentalId < r->rentalId))
+            idMapSet(&newest, r->carId, i);
+    }
+
+    if (unknown > 0)
+    {
+        for (int i = 0; i < rentalTable.count; i++)
+        {
+            Rental *r = rentalAt(i);
+            if (r->isReturned != -1)
+                continue;
+            int car = findCarIndex(r->carId);
+            r->isReturned = !(car != -1 && !carAt(car)->isAvailable && idMapGet(&newest, r->carId) == i);
+        }
+    }
+    free(newest.items);
+
+    // Open rentals from before dates were recorded are taken to start today
+    int now = today(), undated = 0;
+    for (int i = 0; i < rentalTable.count; i++)
+    {
+        Rental *r = rentalAt(i);
+        if (r->endDay == 0 && !r->isReturned)
+        {
+            r->startDay = now;
+            r->endDay = now + (r->days > 0 ? r->days : 1);
+            undated++;
+        }
+    }
+    return unknown + undated;
+}
+
+// --------------------------- Listing Output ---------------------------
+void bufPrintf(OutBuf *out, const char *fmt, ...)
+{
+    va_list ap;
+    for (;;)
+    {
+        size_t room = out->cap - out->len;
+        va_start(ap, fmt);
+        int n = vsnprintf(out->data + out->len, room, fmt, ap);
+        va_end(ap);
+        if (n < 0)
+            return;
+        if ((size_t)n < room)
+        {
+            out->len += n;
+            return;
+        }
+        out->cap = out->cap ? out->cap * 2 : 4096;
+        while (out->cap - out->len <= (size_t)n)
+            out->cap *= 2;
+        out->data = xrealloc(out->data, out->cap);
+    }
+}
+
+// Write the whole buffer with as few write() calls as the kernel allows and
+// empty it for the next screen.
+void bufFlush(OutBuf *out)
+{
+    fflush(stdout); // keep anything already printed ahead of the buffer
+    bufWrite(out, STDOUT_FILENO);
+}
+
+// Same for any file; returns 0 if not all of it could be written.
+int bufWrite(OutBuf *out, int fd)
+{
+    size_t done = 0;
+    while (done < out->len)
+    {
+        ssize_t n = write(fd, out->data + done, out->len - done);
+        if (n <= 0)
+            break;
+        done += n;
+    }
+    int ok = done == out->len;
+    out->len = 0;
+    return ok;
+}
+
+// Ask where to go after a page; moves offset and returns 0 to stop.
+int pagePrompt(int *offset, int total)
+{
+    char choice;
+    for (;;)
+    {
+        printf("[n] Next  [p] Previous  [q] Back: ");
+        if (scanf(" %c", &choice) != 1)
+            return 0;
+        switch (choice)
+        {
+        case 'n':
+        case 'N':
+            if (*offset + LIST_PAGE_SIZE < total)
+            {
+                *offset += LIST_PAGE_SIZE;
+                return 1;
+            }
+            printf("Already on the last page.\n");
+            break;
+        case 'p':
+        case 'P':
+            if (*offset > 0)
+            {
+                *offset -= LIST_PAGE_SIZE;
+                return 1;
+            }
+            printf("Already on the first page.\n");
+            break;
+        case 'q':
+        case 'Q':
+            return 0;
+        default:
+            printf("Invalid choice! Try again.\n");
+        }
+    }
+}
+
+// --------------------------- Cars ---------------------------
+void addCar()
+{
+    Car c;
+    char brand[NAME_LENGTH], model[NAME_LENGTH], branch[NAME_LENGTH];
+
+    printf("Enter Car Brand: ");
+    fgets(brand, sizeof(brand), stdin);
+    fix_gets_input(brand);
+
+    printf("Enter Car Model: ");
+    fgets(model, sizeof(model), stdin);
+    fix_gets_input(model);
+
+     // Check for duplicate Brand+Model
+    if (findCarByName(brand, model) != -1)
+    {
+        printf("❌ This car is already added!\n");
+        return;
+    }
+
+    printf("Enter Year: ");
+    scanf("%d", &c.year);
+    while (getchar() != '\n');
+
+    printf("Enter Price per Day: ");
+    scanf("%f", &c.pricePerDay);
+    while (getchar() != '\n');
+
+    printf("Enter Branch (blank for %s): ", BRANCH_DEFAULT);
+    fgets(branch, sizeof(branch), stdin);
+    fix_gets_input(branch);
+
+    if (doAddCar(brand, model, c.year, c.pricePerDay, branch) == -1)
+    {
+        printf("❌ Could not add the car! Brand, model and branch must not contain commas, and the car must be new.\n");
+        return;
+    }
+    printf("✅ Car Added Successfully!\n");
 }
 
 // void listCars()
@@ -426,395 +3715,3600 @@ void addCar()
 //     printf("---------------------------------------------------------------------------------\n");
 // }
 
-void listCars()
+void listCars()
+{
+    if (liveCarCount() == 0)
+    {
+        printf("❌ No cars available!\n");
+        return;
+    }
+
+    char choice;
+    do
+    {
+        printf("\n----------------------------------------------------\n");
+        printf("List & Sort Cars\n");
+        printf("----------------------------------------------------\n");
+        printf("1. Sort by Car ID\n");
+        printf("2. Sort by Brand\n");
+        printf("3. Sort by Model\n");
+        printf("4. Sort by Year\n");
+        printf("5. Sort by Cost/Day\n");
+        printf("6. Sort by Status\n");
+        printf("7. Exit to Menu\n");
+        printf("\nEnter your choice: ");
+        scanf(" %c", &choice);
+
+        // Listing only walks an index; the cars themselves never move.
+        SkipList *index;
+        switch (choice)
+        {
+        case '1': index = &carsById; break;
+        case '2': index = &carsByBrand; break;
+        case '3': index = &carsByModel; break;
+        case '4': index = &carsByYear; break;
+        case '5': index = &carsByPrice; break;
+        case '6': index = &carsByStatus; break;
+        case '7': continue;
+        default: printf("Invalid choice! Try again.\n"); continue;
+        }
+
+        // Each page seeks straight to its first row and touches only the
+        // rows it shows.
+        int offset = 0;
+        do
+        {
+            long long t0 = nowNanos();
+            int total = index->length;
+            OutBuf *out = &listBuf;
+            bufPrintf(out, "---------------------------------------------------------------------------------\n");
+            bufPrintf(out, "%-8s %-15s %-15s %-12s %-6s %10s %9s\n", "Car ID", "Brand", "Model", "Branch", "Year", "Cost/Day", "Status");
+            bufPrintf(out, "---------------------------------------------------------------------------------\n");
+            SkipNode *n = skipSeek(index, offset);
+            for (int i = 0; n && i < LIST_PAGE_SIZE; i++, n = n->next[0].node)
+                printCarRow(out, carAt(n->slot));
+            bufPrintf(out, "---------------------------------------------------------------------------------\n");
+            if (total > LIST_PAGE_SIZE)
+                bufPrintf(out, "Cars %d-%d of %d (page %d/%d)\n", offset + 1,
+                          offset + LIST_PAGE_SIZE < total ? offset + LIST_PAGE_SIZE : total, total,
+                          offset / LIST_PAGE_SIZE + 1, (total + LIST_PAGE_SIZE - 1) / LIST_PAGE_SIZE);
+            bufFlush(out);
+            metricRecord(METRIC_LIST_CARS, t0, 1);
+        } while (index->length > LIST_PAGE_SIZE && pagePrompt(&offset, index->length));
+
+    } while (choice != '7');
+}
+
+void searchCars()
+{
+    char brand[NAME_LENGTH], branch[NAME_LENGTH];
+    CarQuery q = {.brand = brand, .availableOnly = 1, .branch = branch};
+
+    printf("Branch (blank for any): ");
+    fgets(branch, sizeof(branch), stdin);
+    fix_gets_input(branch);
+
+    printf("Brand (blank for any): ");
+    fgets(brand, sizeof(brand), stdin);
+    fix_gets_input(brand);
+
+    printf("Minimum price per day (0 for none): ");
+    scanf("%f", &q.minPrice);
+    while (getchar() != '\n')
+        ;
+    printf("Maximum price per day (0 for none): ");
+    scanf("%f", &q.maxPrice);
+    while (getchar() != '\n')
+        ;
+    printf("Minimum year (0 for any): ");
+    scanf("%d", &q.minYear);
+    while (getchar() != '\n')
+        ;
+
+    static IntVec hits = {0};
+    double t0 = nowSeconds();
+    int total = doSearchCars(&q, &hits);
+    double elapsed = nowSeconds() - t0;
+    if (total == 0)
+    {
+        printf("❌ No available cars match.\n");
+        return;
+    }
+
+    int offset = 0;
+    do
+    {
+        int end = offset + LIST_PAGE_SIZE < total ? offset + LIST_PAGE_SIZE : total;
+        OutBuf *out = &listBuf;
+        bufPrintf(out, "---------------------------------------------------------------------------------\n");
+        bufPrintf(out, "%-8s %-15s %-15s %-12s %-6s %10s %9s\n", "Car ID", "Brand", "Model", "Branch", "Year", "Cost/Day", "Status");
+        bufPrintf(out, "---------------------------------------------------------------------------------\n");
+        for (int i = offset; i < end; i++)
+            printCarRow(out, carAt(hits.items[i]));
+        bufPrintf(out, "---------------------------------------------------------------------------------\n");
+        bufPrintf(out, "Cars %d-%d of %d matching (searched in %.0f us)\n", offset + 1, end, total, elapsed * 1e6);
+        bufFlush(out);
+    } while (total > LIST_PAGE_SIZE && pagePrompt(&offset, total));
+}
+
+// The k cheapest, newest or most rented cars available today.
+void topCars()
+{
+    int kind, k;
+    char branch[NAME_LENGTH];
+    printf("1. Cheapest\n2. Newest\n3. Most Rented\n");
+    printf("Enter choice: ");
+    if (scanf("%d", &kind) != 1)
+        kind = 0;
+    while (getchar() != '\n')
+        ;
+    if (kind < 1 || kind > 3)
+    {
+        printf("Invalid choice!\n");
+        return;
+    }
+
+    printf("How many (1-%d): ", LIST_PAGE_SIZE);
+    if (scanf("%d", &k) != 1)
+        k = 0;
+    while (getchar() != '\n')
+        ;
+    if (k < 1 || k > LIST_PAGE_SIZE)
+    {
+        printf("❌ Enter a number from 1 to %d.\n", LIST_PAGE_SIZE);
+        return;
+    }
+
+    printf("Branch (blank for any): ");
+    fgets(branch, sizeof(branch), stdin);
+    fix_gets_input(branch);
+
+    static IntVec hits = {0};
+    double t0 = nowSeconds();
+    int total = doTopCars(kind - 1, k, branch, &hits);
+    double elapsed = nowSeconds() - t0;
+    if (total <= 0)
+    {
+        printf("❌ No available cars.\n");
+        return;
+    }
+
+    OutBuf *out = &listBuf;
+    bufPrintf(out, "---------------------------------------------------------------------------------------\n");
+    bufPrintf(out, "%-8s %-15s %-15s %-12s %-6s %10s %9s %5s\n", "Car ID", "Brand", "Model", "Branch", "Year", "Cost/Day", "Status", "Rents");
+    bufPrintf(out, "---------------------------------------------------------------------------------------\n");
+    for (int i = 0; i < total; i++)
+    {
+        const Car *c = carAt(hits.items[i]);
+        bufPrintf(out, "%-8d %-15s %-15s %-12s %-6d %10.02f %9s %5d\n",
+                  c->id, carBrand(c), carModel(c), carBranch(c), c->year, c->pricePerDay,
+                  c->isAvailable ? "Available" : "Rented", carStats(hits.items[i])->rentals);
+    }
+    bufPrintf(out, "---------------------------------------------------------------------------------------\n");
+    bufPrintf(out, "Top %d of the available cars (found in %.0f us)\n", total, elapsed * 1e6);
+    bufFlush(out);
+}
+
+void findCars()
+{
+    char text[NAME_LENGTH];
+    printf("Brand or model (the start of it will do): ");
+    fgets(text, sizeof(text), stdin);
+    fix_gets_input(text);
+
+    static IntVec hits = {0};
+    double t0 = nowSeconds();
+    int total = doFindCars(text, &hits);
+    double elapsed = nowSeconds() - t0;
+    if (total <= 0)
+    {
+        printf("❌ No cars match \"%s\".\n", text);
+        return;
+    }
+
+    int offset = 0;
+    do
+    {
+        int end = offset + LIST_PAGE_SIZE < total ? offset + LIST_PAGE_SIZE : total;
+        OutBuf *out = &listBuf;
+        bufPrintf(out, "---------------------------------------------------------------------------------\n");
+        bufPrintf(out, "%-8s %-15s %-15s %-12s %-6s %10s %9s\n", "Car ID", "Brand", "Model", "Branch", "Year", "Cost/Day", "Status");
+        bufPrintf(out, "---------------------------------------------------------------------------------\n");
+        for (int i = offset; i < end; i++)
+            printCarRow(out, carAt(hits.items[i]));
+        bufPrintf(out, "---------------------------------------------------------------------------------\n");
+        bufPrintf(out, "Cars %d-%d of %d matching \"%s\" (found in %.0f us)\n", offset + 1, end, total, text, elapsed * 1e6);
+        bufFlush(out);
+    } while (total > LIST_PAGE_SIZE && pagePrompt(&offset, total));
+}
+
+void findCustomers()
+{
+    char text[CUSTOMER_NAME_LENGTH];
+    printf("Customer name (the start of it will do): ");
+    fgets(text, sizeof(text), stdin);
+    fix_gets_input(text);
+
+    static IntVec users = {0};
+    int total = doFindCustomers(text, &users);
+    if (total <= 0)
+    {
+        printf("❌ No customers match \"%s\".\n", text);
+        return;
+    }
+
+    OutBuf *out = &listBuf;
+    bufPrintf(out, "----------------------------------------------------------\n");
+    bufPrintf(out, "%-30s %8s %6s %12s\n", "Customer", "Rentals", "Open", "Revenue");
+    bufPrintf(out, "----------------------------------------------------------\n");
+    for (int i = 0; i < total; i++)
+    {
+        int user = users.items[i];
+        int open = 0;
+        IntVec *mine = customerRentals(user);
+        for (int j = 0; j < mine->count; j++)
+            open += !rentalAt(mine->items[j])->isReturned;
+        bufPrintf(out, "%-30s %8d %6d ₹%11.2f\n", userAt(user)->username, customerStats(user)->rentals, open,
+                  customerStats(user)->revenue);
+    }
+    bufPrintf(out, "----------------------------------------------------------\n");
+    bufFlush(out);
+}
+
+
+// --------------------------- Rentals ---------------------------
+void rentCar(const char *username)
+{
+    int id, days;
+    printf("Enter Car ID to Rent: ");
+    scanf("%d", &id);
+    while (getchar() != '\n')
+        ;
+
+    int found = findCarIndex(id);
+    if (found == -1)
+    {
+        printf("❌ Car not available!\n");
+        return;
+    }
+
+    char date[16];
+    printf("Start Date (YYYY-MM-DD, blank for today): ");
+    fgets(date, sizeof(date), stdin);
+    fix_gets_input(date);
+    int start = date[0] ? parseDay(date) : today();
+    if (start < today())
+    {
+        printf("❌ Enter today or a later date as YYYY-MM-DD!\n");
+        return;
+    }
+
+    printf("Enter Number of Days: ");
+    scanf("%d", &days);
+    while (getchar() != '\n')
+        ;
+    if (days < 1)
+    {
+        printf("❌ Rent for at least one day!\n");
+        return;
+    }
+
+    const BookingVec *b = carBookings(found);
+    if (bookingConflict(b, start, start + days))
+    {
+        // Show the booking in the way: the first one ending after start
+        int lo = 0, hi = b->count;
+        while (lo < hi)
+        {
+            int mid = (lo + hi) / 2;
+            if (b->items[mid].endDay <= start)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        char from[11], to[11];
+        formatDay(b->items[lo].startDay, from);
+        formatDay(b->items[lo].endDay, to);
+        printf("❌ Car is booked from %s until %s!\n", from, to);
+        return;
+    }
+
+    int rentalId = doRentCar(username, id, start, days);
+    if (rentalId == -1)
+    {
+        printf("❌ Car not available!\n");
+        return;
+    }
+    Rental r = *rentalAt(findRentalIndex(rentalId));
+
+    // ----- Print Bill -----
+    printf("\n========================================\n");
+    printf("            CAR RENTAL BILL             \n");
+    printf("========================================\n");
+    printf("Rental ID       : %d\n", r.rentalId);
+    printf("Customer Name   : %s\n", rentalCustomer(&r));
+    printf("Car ID          : %d\n", r.carId);
+    printf("Car Brand       : %s\n", carBrand(carAt(found)));
+    printf("Car Model       : %s\n", carModel(carAt(found)));
+    char from[11], to[11];
+    formatDay(r.startDay, from);
+    formatDay(r.endDay, to);
+    printf("Rental Days     : %d (%s until %s)\n", r.days, from, to);
+    printf("Price per Day   : ₹%.2f\n", carAt(found)->pricePerDay);
+    printf("----------------------------------------\n");
+    printf("Total Cost      : ₹%.2f\n", r.totalCost);
+    printf("Status          : %s\n", carAt(found)->isAvailable ? "Available" : "Rented");
+    printf("========================================\n\n");
+}
+
+void returnCar(const char *username)
+{
+    int rid;
+    printf("Enter Rental ID to Return: ");
+    scanf("%d", &rid);
+    while (getchar() != '\n')
+        ;
+
+    int found = findRentalIndex(rid);
+    if (found == -1 || strcmp(rentalCustomer(rentalAt(found)), username) != 0)
+    {
+        printf("❌ Rental not found!\n");
+        return;
+    }
+    if (doReturnCar(username, rid) == -1)
+    {
+        printf("❌ This car has already been returned!\n");
+        return;
+    }
+    int carIndex = findCarIndex(rentalAt(found)->carId);
+
+    // Print return receipt
+    printf("\n========================================\n");
+    printf("         CAR RETURN RECEIPT             \n");
+    printf("========================================\n");
+    printf("Rental ID       : %d\n", rentalAt(found)->rentalId);
+    printf("Customer Name   : %s\n", rentalCustomer(rentalAt(found)));
+    printf("Car ID          : %d\n", rentalAt(found)->carId);
+    if (carIndex != -1)
+    {
+        printf("Car Brand       : %s\n", carBrand(carAt(carIndex)));
+        printf("Car Model       : %s\n", carModel(carAt(carIndex)));
+        printf("Price per Day   : ₹%.2f\n", carAt(carIndex)->pricePerDay);
+    }
+    char from[11], to[11];
+    formatDay(rentalAt(found)->startDay, from);
+    formatDay(rentalAt(found)->endDay, to);
+    printf("Rental Days     : %d (%s until %s)\n", rentalAt(found)->days, from, to);
+    printf("----------------------------------------\n");
+    printf("Total Cost      : ₹%.2f\n", rentalAt(found)->totalCost);
+    printf("Status          : Returned ✅\n");
+    printf("========================================\n\n");
+
+    printf("✅ Car Returned Successfully!\n");
+}
+
+// --------------------------- Delete Car ---------------------------
+void deleteCar()
+{
+    int id;
+    printf("Enter Car ID to Delete: ");
+    scanf("%d", &id);
+    while (getchar() != '\n')
+        ; // clear newline
+
+    int found = findCarIndex(id);
+    if (found != -1 && carBookings(found)->count > 0)
+    {
+        printf("❌ Car is rented out or booked; it can be deleted once those rentals end.\n");
+        return;
+    }
+    if (doDeleteCar(id) == -1)
+    {
+        printf("❌ Car not found!\n");
+        return;
+    }
+    printf("✅ Car Deleted!\n");
+}
+
+// --------------------------- Fleet Import/Export ---------------------------
+void importCars()
+{
+    char path[256];
+    printf("Enter CSV file to import (%s): ", FLEET_CSV_HEADER);
+    fgets(path, sizeof(path), stdin);
+    fix_gets_input(path);
+
+    int duplicates;
+    int added = doImportCars(path, &duplicates);
+    if (added == -1)
+    {
+        printf("❌ Could not read %s!\n", path);
+        return;
+    }
+    printf("✅ %d car(s) added", added);
+    if (duplicates > 0)
+        printf(", %d already in the fleet skipped", duplicates);
+    printf(".\n");
+}
+
+void exportCars()
+{
+    char path[256];
+    printf("Enter CSV file to export to: ");
+    fgets(path, sizeof(path), stdin);
+    fix_gets_input(path);
+
+    int count = doExportCars(path);
+    if (count == -1)
+        printf("❌ Could not write %s!\n", path);
+    else
+        printf("✅ %d car(s) exported to %s!\n", count, path);
+}
+
+void listRentals()
+{
+    if (historyTotal + rentalTable.count == 0)
+    {
+        printf("❌ No rentals yet!\n");
+        return;
+    }
+    // Archived rentals first, then the table in slot order, so a page is a
+    // plain index range; only the segments a page touches are read.
+    int offset = 0;
+    do
+    {
+        int total = historyTotal + rentalTable.count;
+        int end = offset + LIST_PAGE_SIZE < total ? offset + LIST_PAGE_SIZE : total;
+        OutBuf *out = &listBuf;
+        bufPrintf(out, "\n---------------------------------------------------------------------------------\n");
+        bufPrintf(out, "Rental List\n");
+        bufPrintf(out, "---------------------------------------------------------------------------------\n");
+        bufPrintf(out, "%-9s %-16s %-6s %-10s %-10s %14s %9s\n", "Rental ID", "User", "CarID", "From", "Until", "Total Cost", "Status");
+        bufPrintf(out, "---------------------------------------------------------------------------------\n");
+
+        for (int i = offset; i < end; i++)
+        {
+            const Rental *r = i < historyTotal ? historyAt(i) : rentalAt(i - historyTotal);
+            if (!r)
+                continue;
+            char from[11], to[11];
+            formatDay(r->startDay, from);
+            formatDay(r->endDay, to);
+            bufPrintf(out, "%-9d %-16s %-6d %-10s %-10s ₹%13.2f %9s\n", r->rentalId, rentalCustomer(r), r->carId, from, to,
+                      r->totalCost, r->isReturned ? "Returned" : "Open");
+        }
+
+        bufPrintf(out, "---------------------------------------------------------------------------------\n");
+        if (total > LIST_PAGE_SIZE)
+            bufPrintf(out, "Rentals %d-%d of %d (page %d/%d)\n", offset + 1, end, total,
+                      offset / LIST_PAGE_SIZE + 1, (total + LIST_PAGE_SIZE - 1) / LIST_PAGE_SIZE);
+        bufFlush(out);
+    } while (historyTotal + rentalTable.count > LIST_PAGE_SIZE && pagePrompt(&offset, historyTotal + rentalTable.count));
+}
+
+// Only the customer's own rentals: the current ones straight from the
+// per-customer index, archived ones from the history segments that hold
+// any of theirs.
+void listMyRentals(const char *username)
+{
+    int user = findUserIndex(username);
+    if (user == -1)
+        return;
+    IntVec *mine = customerRentals(user);
+    Rental *archived = NULL;
+    int archivedCount = historyFind(username, &archived);
+    int total = mine->count + archivedCount;
+    if (total == 0)
+    {
+        printf("❌ You have no rentals yet!\n");
+        return;
+    }
+
+    // Newest first
+    int offset = 0;
+    do
+    {
+        int end = offset + LIST_PAGE_SIZE < total ? offset + LIST_PAGE_SIZE : total;
+        OutBuf *out = &listBuf;
+        bufPrintf(out, "\n---------------------------------------------------------------------------------\n");
+        bufPrintf(out, "My Rentals\n");
+        bufPrintf(out, "---------------------------------------------------------------------------------\n");
+        bufPrintf(out, "%-9s %-5s %-12s %-12s %-10s %-10s %10s %8s\n", "Rental ID", "CarID", "Brand", "Model", "From", "Until", "Cost", "Status");
+        bufPrintf(out, "---------------------------------------------------------------------------------\n");
+        for (int i = offset; i < end; i++)
+        {
+            const Rental *r = i < mine->count ? rentalAt(mine->items[mine->count - 1 - i]) : &archived[total - 1 - i];
+            int car = findCarIndex(r->carId);
+            char from[11], to[11];
+            formatDay(r->startDay, from);
+            formatDay(r->endDay, to);
+            bufPrintf(out, "%-9d %-5d %-12.12s %-12.12s %-10s %-10s ₹%9.2f %8s\n", r->rentalId, r->carId,
+                      car == -1 ? "(deleted)" : carBrand(carAt(car)), car == -1 ? "" : carModel(carAt(car)),
+                      from, to, r->totalCost, r->isReturned ? "Returned" : "Open");
+        }
+        bufPrintf(out, "---------------------------------------------------------------------------------\n");
+        if (total > LIST_PAGE_SIZE)
+            bufPrintf(out, "Rentals %d-%d of %d (page %d/%d)\n", offset + 1, end, total,
+                      offset / LIST_PAGE_SIZE + 1, (total + LIST_PAGE_SIZE - 1) / LIST_PAGE_SIZE);
+        bufFlush(out);
+    } while (total > LIST_PAGE_SIZE && pagePrompt(&offset, total));
+    free(archived);
+}
+
+// Is one car free for a window, or which cars are.
+void checkAvailability()
+{
+    int id, days;
+    char date[16], branch[NAME_LENGTH] = "";
+    printf("Car ID (0 for all cars): ");
+    scanf("%d", &id);
+    while (getchar() != '\n')
+        ;
+    if (id == 0)
+    {
+        printf("Branch (blank for all): ");
+        fgets(branch, sizeof(branch), stdin);
+        fix_gets_input(branch);
+    }
+    printf("From (YYYY-MM-DD, blank for today): ");
+    fgets(date, sizeof(date), stdin);
+    fix_gets_input(date);
+    int start = date[0] ? parseDay(date) : today();
+    printf("Number of Days: ");
+    scanf("%d", &days);
+    while (getchar() != '\n')
+        ;
+    if (start < 0 || days < 1)
+    {
+        printf("❌ Enter a date as YYYY-MM-DD and at least one day!\n");
+        return;
+    }
+
+    char from[11], to[11];
+    formatDay(start, from);
+    formatDay(start + days, to);
+    if (id != 0)
+    {
+        int found = findCarIndex(id);
+        if (found == -1)
+            printf("❌ Car not found!\n");
+        else if (bookingConflict(carBookings(found), start, start + days))
+            printf("❌ Car %d is booked during %s until %s.\n", id, from, to);
+        else
+            printf("✅ Car %d is free from %s until %s.\n", id, from, to);
+        return;
+    }
+
+    static IntVec hits = {0};
+    int total = doFreeCars(start, start + days, branch, &hits);
+    if (total == 0)
+    {
+        printf("❌ No car is free from %s until %s.\n", from, to);
+        return;
+    }
+    int offset = 0;
+    do
+    {
+        int end = offset + LIST_PAGE_SIZE < total ? offset + LIST_PAGE_SIZE : total;
+        OutBuf *out = &listBuf;
+        bufPrintf(out, "---------------------------------------------------------------------------------\n");
+        bufPrintf(out, "%-8s %-15s %-15s %-12s %-6s %10s %9s\n", "Car ID", "Brand", "Model", "Branch", "Year", "Cost/Day", "Status");
+        bufPrintf(out, "---------------------------------------------------------------------------------\n");
+        for (int i = offset; i < end; i++)
+            printCarRow(out, carAt(hits.items[i]));
+        bufPrintf(out, "---------------------------------------------------------------------------------\n");
+        bufPrintf(out, "Cars %d-%d of %d free from %s until %s\n", offset + 1, end, total, from, to);
+        bufFlush(out);
+    } while (total > LIST_PAGE_SIZE && pagePrompt(&offset, total));
+}
+
+// --------------------------- File Handling ---------------------------
+void loadData()
+{
+    long long t0 = nowNanos();
+    journalOffset = 0;
+    int version = loadSnapshot(); // 0 if there was none
+    if (!version)
+        importText();
+    historyPrune();
+    historyRefsRebuild();
+    userHashRebuild();
+    carIndexRebuild();
+    customerRentalsRebuild();
+    // With other instances running, only the records they have finished
+    // are read; otherwise the whole journal is this instance's to settle
+    int alone = sharedAlone();
+    if (!alone)
+        sharedAwaitWrites();
+    journalReplay(journalOffset, alone ? -1 : shared->journalSize);
+    if (shared && alone)
+        shared->journalSize = journalOffset;
+
+    // Imported text files are upgraded once and saved at once: plaintext
+    // passwords are hashed so the plaintext leaves the disk, rentals get a
+    // returned status and the totals are counted.
+    int upgraded = 0;
+    if (!version)
+        upgraded = migratePasswords() + resolveRentalStatus() + statsRebuild();
+    carBookingsRebuild();
+    statsRecount();
+
+    // Rentals returned since the last archive (before a crash, or in data
+    // that was imported) leave the hot table now.
+    int closed = 0;
+    for (int i = 0; i < rentalTable.count && !closed; i++)
+        closed = rentalAt(i)->isReturned;
+    if (closed)
+        archiveRentals();
+    else if (upgraded > 0)
+        checkpoint();
+    metricRecord(METRIC_LOAD, t0, 1);
+}
+
+// Append one section at the next SNAPSHOT_ALIGN boundary after *pos,
+// either from a table (data == NULL) or from a flat array.
+int writeSection(FILE *fp, SnapshotSection *sec, long long *pos, const Table *t, const void *data, size_t elemSize, long long count)
+{
+    *pos = (*pos + SNAPSHOT_ALIGN - 1) / SNAPSHOT_ALIGN * SNAPSHOT_ALIGN;
+    sec->offset = *pos;
+    sec->count = count;
+    sec->elemSize = elemSize;
+    *pos += count * (long long)elemSize;
+
+    if (fseek(fp, sec->offset, SEEK_SET) != 0)
+        return 0;
+    if (!t)
+        return fwrite(data, elemSize, count, fp) == (size_t)count;
+
+    for (int k = 0; k << TABLE_CHUNK_SHIFT < count; k++)
+    {
+        int n = count - (k << TABLE_CHUNK_SHIFT);
+        if (n > TABLE_CHUNK_SIZE)
+            n = TABLE_CHUNK_SIZE;
+        if (fwrite(t->chunks[k], elemSize, n, fp) != (size_t)n)
+            return 0;
+    }
+    return 1;
+}
+
+// Write the tables to SNAPSHOT_FILE. The new file is written under a
+// temporary name and renamed over the old one, so a crash never leaves a
+// half-written snapshot behind.
+void saveData()
+{
+    long long t0 = nowNanos();
+    SnapshotHeader h = {0};
+    h.magic = SNAPSHOT_MAGIC;
+    h.version = SNAPSHOT_VERSION;
+    h.nextCarId = nextCarId;
+    h.nextRentalId = nextRentalId;
+
+    FILE *fp = fopen(SNAPSHOT_TMP_FILE, "wb");
+    if (!fp)
+    {
+        printf("❌ Could not write %s!\n", SNAPSHOT_TMP_FILE);
+        metricRecord(METRIC_SAVE, t0, 0);
+        return;
+    }
+
+    long long pos = sizeof(h);
+    SnapshotSection *sec = h.sections;
+    int ok = writeSection(fp, &sec[SECTION_USERS], &pos, &userTable, NULL, sizeof(User), userTable.count) &&
+             writeSection(fp, &sec[SECTION_CARS], &pos, &carTable, NULL, sizeof(Car), carTable.count) &&
+             writeSection(fp, &sec[SECTION_RENTALS], &pos, &rentalTable, NULL, sizeof(Rental), rentalTable.count) &&
+             writeSection(fp, &sec[SECTION_CAR_IDS], &pos, NULL, carSlotById.items, sizeof(int), carSlotById.count) &&
+             writeSection(fp, &sec[SECTION_RENTAL_IDS], &pos, NULL, rentalSlotById.items, sizeof(int), rentalSlotById.count) &&
+             writeSection(fp, &sec[SECTION_FREE_CARS], &pos, NULL, freeCarSlots.items, sizeof(int), freeCarSlots.count) &&
+             writeSection(fp, &sec[SECTION_CAR_STATS], &pos, &carStatsTable, NULL, sizeof(RentalTotals), carStatsTable.count) &&
+             writeSection(fp, &sec[SECTION_CUSTOMER_STATS], &pos, &customerStatsTable, NULL, sizeof(RentalTotals), customerStatsTable.count) &&
+             writeSection(fp, &sec[SECTION_BRAND_STATS], &pos, &brandTable, NULL, sizeof(BrandStats), brandTable.count) &&
+             writeSection(fp, &sec[SECTION_FLEET_STATS], &pos, NULL, &fleetStats, sizeof(FleetStats), 1) &&
+             writeSection(fp, &sec[SECTION_HISTORY], &pos, NULL, historyCounts.items, sizeof(int), historyCounts.count) &&
+             writeSection(fp, &sec[SECTION_BRAND_NAMES], &pos, &brandDict.names, NULL, NAME_LENGTH, brandDict.names.count) &&
+             writeSection(fp, &sec[SECTION_MODEL_NAMES], &pos, &modelDict.names, NULL, NAME_LENGTH, modelDict.names.count) &&
+             writeSection(fp, &sec[SECTION_CUSTOMER_NAMES], &pos, &customerDict.names, NULL, CUSTOMER_NAME_LENGTH, customerDict.names.count) &&
+             writeSection(fp, &sec[SECTION_JOURNAL], &pos, NULL, &journalOffset, sizeof(journalOffset), 1) &&
+             writeSection(fp, &sec[SECTION_BRANCH_NAMES], &pos, &branchDict.names, NULL, NAME_LENGTH, branchDict.names.count) &&
+             writeSection(fp, &sec[SECTION_BRANCH_STATS], &pos, &branchTable, NULL, sizeof(BrandStats), branchTable.count) &&
+             writeSection(fp, &sec[SECTION_HISTORY_REFS], &pos, &historyRefTable, NULL, sizeof(HistoryRef), historyRefTable.count);
+
+    // The header goes last so it describes the sections actually written
+    ok = ok && fseek(fp, 0, SEEK_SET) == 0 && fwrite(&h, sizeof(h), 1, fp) == 1;
+    ok = ok && fflush(fp) == 0 && fsync(fileno(fp)) == 0;
+    ok = fclose(fp) == 0 && ok;
+
+    ok = ok && rename(SNAPSHOT_TMP_FILE, SNAPSHOT_FILE) == 0;
+    if (!ok)
+    {
+        printf("❌ Could not save %s!\n", SNAPSHOT_FILE);
+        remove(SNAPSHOT_TMP_FILE);
+    }
+    metricRecord(METRIC_SAVE, t0, ok);
+}
+
+// Copy a flat int section into a vector (the vector has to be able to grow).
+void loadIntSection(IntVec *v, const char *base, const SnapshotSection *sec)
+{
+    intVecResize(v, 0);
+    intVecResize(v, sec->count);
+    if (sec->count)
+        memcpy(v->items, base + sec->offset, sec->count * sizeof(int));
+}
+
+// Map SNAPSHOT_FILE privately and use its records in place: nothing is
+// parsed, and changes made in memory never touch the file. The mapping is
+// kept for the life of the process. Returns 0 if there is no usable
+// snapshot.
+int loadSnapshot()
+{
+    int fd = open(SNAPSHOT_FILE, O_RDONLY);
+    if (fd < 0)
+        return 0;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(SnapshotHeader))
+    {
+        close(fd);
+        return 0;
+    }
+
+    char *base = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED)
+        return 0;
+
+    size_t elemSizes[SECTION_COUNT] = {
+        [SECTION_USERS] = sizeof(User),
+        [SECTION_CARS] = sizeof(Car),
+        [SECTION_RENTALS] = sizeof(Rental),
+        [SECTION_CAR_IDS] = sizeof(int),
+        [SECTION_RENTAL_IDS] = sizeof(int),
+        [SECTION_FREE_CARS] = sizeof(int),
+        [SECTION_CAR_STATS] = sizeof(RentalTotals),
+        [SECTION_CUSTOMER_STATS] = sizeof(RentalTotals),
+        [SECTION_BRAND_STATS] = sizeof(BrandStats),
+        [SECTION_FLEET_STATS] = sizeof(FleetStats),
+        [SECTION_HISTORY] = sizeof(int),
+        [SECTION_BRAND_NAMES] = NAME_LENGTH,
+        [SECTION_MODEL_NAMES] = NAME_LENGTH,
+        [SECTION_CUSTOMER_NAMES] = CUSTOMER_NAME_LENGTH,
+        [SECTION_JOURNAL] = sizeof(long long),
+        [SECTION_BRANCH_NAMES] = NAME_LENGTH,
+        [SECTION_BRANCH_STATS] = sizeof(BrandStats),
+        [SECTION_HISTORY_REFS] = sizeof(HistoryRef),
+    };
+    const SnapshotHeader *h = (const SnapshotHeader *)base;
+    long long headerSize = sizeof(SnapshotHeader);
+    int ok = h->magic == SNAPSHOT_MAGIC && h->version == SNAPSHOT_VERSION;
+    for (int i = 0; i < SECTION_COUNT && ok; i++)
+    {
+        const SnapshotSection *sec = &h->sections[i];
+        ok = sec->elemSize == (long long)elemSizes[i] && sec->count >= 0 && sec->count <= 0x7fffffff &&
+             (sec->count == 0 || (sec->offset >= headerSize && sec->offset + sec->count * sec->elemSize <= st.st_size));
+    }
+    ok = ok && h->sections[SECTION_FLEET_STATS].count <= 1 && h->sections[SECTION_JOURNAL].count == 1;
+    if (!ok)
+    {
+        printf("❌ %s is damaged or from another version, importing text files instead.\n", SNAPSHOT_FILE);
+        munmap(base, st.st_size);
+        return 0;
+    }
+
+    const SnapshotSection *sec = h->sections;
+    tableAttach(&userTable, base + sec[SECTION_USERS].offset, sec[SECTION_USERS].count);
+    tableAttach(&carTable, base + sec[SECTION_CARS].offset, sec[SECTION_CARS].count);
+    tableAttach(&rentalTable, base + sec[SECTION_RENTALS].offset, sec[SECTION_RENTALS].count);
+    tableAttach(&carStatsTable, base + sec[SECTION_CAR_STATS].offset, sec[SECTION_CAR_STATS].count);
+    tableAttach(&customerStatsTable, base + sec[SECTION_CUSTOMER_STATS].offset, sec[SECTION_CUSTOMER_STATS].count);
+    tableAttach(&brandTable, base + sec[SECTION_BRAND_STATS].offset, sec[SECTION_BRAND_STATS].count);
+    tableAttach(&branchTable, base + sec[SECTION_BRANCH_STATS].offset, sec[SECTION_BRANCH_STATS].count);
+    fleetStats = (FleetStats){0};
+    if (sec[SECTION_FLEET_STATS].count == 1)
+        memcpy(&fleetStats, base + sec[SECTION_FLEET_STATS].offset, sizeof(fleetStats));
+    tableAttach(&brandDict.names, base + sec[SECTION_BRAND_NAMES].offset, sec[SECTION_BRAND_NAMES].count);
+    tableAttach(&modelDict.names, base + sec[SECTION_MODEL_NAMES].offset, sec[SECTION_MODEL_NAMES].count);
+    tableAttach(&customerDict.names, base + sec[SECTION_CUSTOMER_NAMES].offset, sec[SECTION_CUSTOMER_NAMES].count);
+    tableAttach(&branchDict.names, base + sec[SECTION_BRANCH_NAMES].offset, sec[SECTION_BRANCH_NAMES].count);
+    dictRebuild(&brandDict);
+    dictRebuild(&modelDict);
+    dictRebuild(&customerDict);
+    dictRebuild(&branchDict);
+    loadIntSection(&carSlotById, base, &sec[SECTION_CAR_IDS]);
+    loadIntSection(&rentalSlotById, base, &sec[SECTION_RENTAL_IDS]);
+    loadIntSection(&freeCarSlots, base, &sec[SECTION_FREE_CARS]);
+    loadIntSection(&historyCounts, base, &sec[SECTION_HISTORY]);
+    tableAttach(&historyRefTable, base + sec[SECTION_HISTORY_REFS].offset, sec[SECTION_HISTORY_REFS].count);
+    nextCarId = h->nextCarId;
+    nextRentalId = h->nextRentalId;
+    memcpy(&journalOffset, base + sec[SECTION_JOURNAL].offset, sizeof(journalOffset));
+
+    if (snapshotBase)
+        munmap(snapshotBase, snapshotSize);
+    snapshotBase = base;
+    snapshotSize = st.st_size;
+    return SNAPSHOT_VERSION;
+}
+
+// The text files are an import/export format only: they are read when no
+// snapshot exists yet and written on request from the admin menu.
+void exportText()
+{
+    FILE *fp;
+
+    // Users
+    fp = fopen("users.txt", "w");
+    if (fp)
+    {
+        fprintf(fp, "%d\n", userTable.count);
+        for (int i = 0; i < userTable.count; i++)
+            fprintf(fp, "%s,%s,%d\n", userAt(i)->username, userAt(i)->password, userAt(i)->isAdmin);
+        fclose(fp);
+    }
+
+    // Cars
+    fp = fopen("cars.txt", "w");
+    if (fp)
+    {
+        fprintf(fp, "%d\n", liveCarCount());
+        for (int i = 0; i < carTable.count; i++)
+            if (carAt(i)->id)
+                fprintf(fp, "%d,%s,%s,%d,%.2f,%d,%s\n", carAt(i)->id, carBrand(carAt(i)), carModel(carAt(i)), carAt(i)->year, carAt(i)->pricePerDay, carAt(i)->isAvailable, carBranch(carAt(i)));
+        fclose(fp);
+    }
+
+    // Rentals
+    fp = fopen("rentals.txt", "w");
+    if (fp)
+    {
+        // The archived history first, one segment at a time
+        fprintf(fp, "%d\n", historyTotal + rentalTable.count);
+        for (int i = 0; i < historyTotal + rentalTable.count; i++)
+        {
+            const Rental *r = i < historyTotal ? historyAt(i) : rentalAt(i - historyTotal);
+            if (!r)
+                continue;
+            char from[11], to[11];
+            formatDay(r->startDay, from);
+            formatDay(r->endDay, to);
+            fprintf(fp, "%d,%s,%d,%d,%.2f,%d,%s,%s\n", r->rentalId, rentalCustomer(r), r->carId, r->days, r->totalCost, r->isReturned, from, to);
+        }
+        fclose(fp);
+    }
+}
+
+void importText()
+{
+    tableClear(&userTable);
+    tableClear(&carTable);
+    tableClear(&rentalTable);
+    tableClear(&brandTable);
+    tableClear(&carStatsTable);
+    tableClear(&customerStatsTable);
+    fleetStats = (FleetStats){0};
+    dictClear(&brandDict);
+    dictClear(&modelDict);
+    dictClear(&customerDict);
+    intVecResize(&historyCounts, 0); // the files hold the whole history
+    tableClear(&historyRefTable);
+    historyTotal = 0;
+
+    importTextFile("users.txt", TEXT_USERS);
+    importTextFile("cars.txt", TEXT_CARS);
+    importTextFile("rentals.txt", TEXT_RENTALS);
+
+    // The text format has no ID counters; continue after the largest ID seen.
+    rebuildCarIndexes();
+    intVecResize(&rentalSlotById, 0);
+    for (int i = 0; i < rentalTable.count; i++)
+        idMapSet(&rentalSlotById, rentalAt(i)->rentalId, i);
+    nextCarId = carSlotById.count > 0 ? carSlotById.count : 1;
+    nextRentalId = rentalSlotById.count > 0 ? rentalSlotById.count : 1;
+}
+
+// Map a text file privately and parse it in place: fields are cut with
+// NUL bytes in the mapping itself and converted without scanf. Files
+// larger than TEXT_PARSE_CHUNK are split at line boundaries and the chunks
+// parsed in parallel; the records are then added in file order. Returns
+// the number of well-formed records, or -1 if the file cannot be read.
+int importTextFile(const char *path, int kind)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return -1;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        close(fd);
+        return 0;
+    }
+    size_t size = st.st_size;
+    char *data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return -1;
+
+    // The first line is the record count, or the column names of a fleet
+    // file
+    char *begin = data, *end = data + size;
+    int headerLines = 0;
+    char *p = begin;
+    size_t header = strlen(FLEET_CSV_HEADER);
+    if (kind != TEXT_FLEET)
+        while (p < end && *p >= '0' && *p <= '9')
+            p++;
+    else if (size >= header && memcmp(p, FLEET_CSV_HEADER, header) == 0)
+    {
+        p += header;
+        if ((size_t)(end - p) >= strlen(FLEET_CSV_BRANCH) && memcmp(p, FLEET_CSV_BRANCH, strlen(FLEET_CSV_BRANCH)) == 0)
+            p += strlen(FLEET_CSV_BRANCH);
+    }
+    while (p < end && *p == '\r')
+        p++;
+    if (p == end || *p == '\n')
+    {
+        begin = p < end ? p + 1 : end;
+        headerLines = 1;
+    }
+
+    int threads = (end - begin) / TEXT_PARSE_CHUNK;
+    int cpus = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads > cpus)
+        threads = cpus;
+    if (threads > TEXT_PARSE_THREADS)
+        threads = TEXT_PARSE_THREADS;
+    if (threads < 1)
+        threads = 1;
+
+    TextChunk *chunks = xrealloc(NULL, threads * sizeof(TextChunk));
+    pthread_t tids[TEXT_PARSE_THREADS];
+    int started[TEXT_PARSE_THREADS] = {0};
+    for (int i = 0; i < threads; i++)
+    {
+        // Each chunk ends just after the first newline past its share
+        char *to = end;
+        if (i < threads - 1)
+        {
+            to = begin + (end - begin) * (i + 1) / threads;
+            if (to < (i ? chunks[i - 1].end : begin))
+                to = chunks[i - 1].end;
+            char *nl = memchr(to, '\n', end - to);
+            to = nl ? nl + 1 : end;
+        }
+        memset(&chunks[i], 0, offsetof(TextChunk, tail));
+        chunks[i].kind = kind;
+        chunks[i].begin = i ? chunks[i - 1].end : begin;
+        chunks[i].end = to;
+        if (i > 0)
+            started[i] = pthread_create(&tids[i], NULL, parseTextChunk, &chunks[i]) == 0;
+    }
+    parseTextChunk(&chunks[0]);
+    for (int i = 1; i < threads; i++)
+    {
+        if (started[i])
+            pthread_join(tids[i], NULL);
+        else
+            parseTextChunk(&chunks[i]);
+    }
+
+    int line = headerLines, errors = 0, records = 0;
+    for (int i = 0; i < threads; i++)
+    {
+        TextChunk *c = &chunks[i];
+        for (int e = 0; e < c->errors && e < TEXT_ERRORS_SHOWN; e++)
+            if (errors + e < TEXT_ERRORS_SHOWN)
+                printf("❌ %s:%d: %s, line skipped.\n", path, line + c->errorLines[e], c->errorText[e]);
+        errors += c->errors;
+        line += c->lines;
+        records += c->count;
+
+        for (int j = 0; j < c->count; j++)
+        {
+            const TextRecord *rec = &c->records[j];
+            if (kind == TEXT_USERS)
+            {
+                User *u = tableAppend(&userTable);
+                memcpy(u->username, rec->name, strlen(rec->name) + 1);
+                memcpy(u->password, rec->text, strlen(rec->text) + 1);
+                u->isAdmin = rec->isAdmin;
+                dictIntern(&customerDict, u->username);
+            }
+            else if (kind == TEXT_CARS)
+            {
+                Car *car = tableAppend(&carTable);
+                *car = rec->car;
+                car->brand = brandIntern(rec->name);
+                car->model = dictIntern(&modelDict, rec->text);
+                car->branch = branchIntern(rec->branch);
+            }
+            else if (kind == TEXT_RENTALS)
+            {
+                Rental *r = tableAppend(&rentalTable);
+                *r = rec->rental;
+                r->customer = dictIntern(&customerDict, rec->name);
+            }
+            else if (findCarByName(rec->name, rec->text) == -1)
+            {
+                Car car = rec->car;
+                car.id = nextCarId++;
+                car.brand = brandIntern(rec->name);
+                car.model = dictIntern(&modelDict, rec->text);
+                car.branch = branchIntern(rec->branch);
+                car.isAvailable = 1;
+                insertCar(&car);
+            }
+        }
+        free(c->records);
+    }
+    if (errors > TEXT_ERRORS_SHOWN)
+        printf("❌ %s: %d more bad lines skipped.\n", path, errors - TEXT_ERRORS_SHOWN);
+    free(chunks);
+    munmap(data, size);
+    return records;
+}
+
+void *parseTextChunk(void *arg)
+{
+    TextChunk *c = arg;
+    char *fields[TEXT_MAX_FIELDS + 1];
+    c->cap = (c->end - c->begin) / 32 + 16;
+    c->records = xrealloc(NULL, c->cap * sizeof(TextRecord));
+
+    for (char *p = c->begin; p < c->end;)
+    {
+        char *line = p;
+        char *nl = memchr(p, '\n', c->end - p);
+        c->lines++;
+        if (nl)
+        {
+            *nl = '\0';
+            p = nl + 1;
+        }
+        else
+        {
+            // The mapping may end exactly at the last byte, so an
+            // unterminated last line is cut in a copy
+            p = c->end;
+            if (c->end - line >= (long)sizeof(c->tail))
+                line = NULL;
+            else
+            {
+                memcpy(c->tail, line, c->end - line);
+                c->tail[c->end - line] = '\0';
+                line = c->tail;
+            }
+        }
+
+        const char *error = "line is too long";
+        if (line)
+        {
+            int n = splitFields(line, fields, TEXT_MAX_FIELDS + 1);
+            if (n == 1 && fields[0][0] == '\0')
+                continue; // blank line
+            if (c->count == c->cap)
+            {
+                c->cap *= 2;
+                c->records = xrealloc(c->records, c->cap * sizeof(TextRecord));
+            }
+            error = parseTextRecord(c->kind, fields, n, &c->records[c->count]);
+            if (!error)
+            {
+                c->count++;
+                continue;
+            }
+        }
+        if (c->errors < TEXT_ERRORS_SHOWN)
+        {
+            c->errorLines[c->errors] = c->lines;
+            c->errorText[c->errors] = error;
+        }
+        c->errors++;
+    }
+    return NULL;
+}
+
+// Fill rec from one line's fields. Returns NULL, or what is wrong with the
+// line.
+const char *parseTextRecord(int kind, char **fields, int n, TextRecord *rec)
+{
+    memset(rec, 0, sizeof(*rec));
+    rec->name = fields[0];
+    rec->text = n > 1 ? fields[1] : "";
+    rec->branch = "";
+    if (kind == TEXT_USERS)
+    {
+        if (n != 3)
+            return "expected username,password,isAdmin";
+        if (fields[0][0] == '\0' || strlen(fields[0]) >= CREDENTIAL_LENGTH)
+            return "username is empty or too long";
+        if (strlen(fields[1]) >= PASSWORD_HASH_LENGTH)
+            return "password is too long";
+        if (!parseIntField(fields[2], &rec->isAdmin))
+            return "isAdmin is not a number";
+        return NULL;
+    }
+
+    if (kind == TEXT_CARS || kind == TEXT_FLEET)
+    {
+        // Fleet files have no id and no status: their cars are new. The
+        // branch was added later and is optional in both.
+        Car *c = &rec->car;
+        int k = kind == TEXT_CARS ? 1 : 0; // the brand's field
+        if (kind == TEXT_CARS && n != 6 && n != 7)
+            return "expected id,brand,model,year,price,isAvailable[,branch]";
+        if (kind == TEXT_FLEET && n != 4 && n != 5)
+            return "expected " FLEET_CSV_HEADER "[" FLEET_CSV_BRANCH "]";
+        if (kind == TEXT_CARS && (!parseIntField(fields[0], &c->id) || c->id <= 0))
+            return "car ID is not a positive number";
+        if (fields[k][0] == '\0' || strlen(fields[k]) >= NAME_LENGTH)
+            return "brand is empty or too long";
+        if (fields[k + 1][0] == '\0' || strlen(fields[k + 1]) >= NAME_LENGTH)
+            return "model is empty or too long";
+        if (!parseIntField(fields[k + 2], &c->year))
+            return "year is not a number";
+        if (!parseFloatField(fields[k + 3], &c->pricePerDay))
+            return "price is not a number";
+        if (kind == TEXT_CARS && !parseIntField(fields[5], &c->isAvailable))
+            return "isAvailable is not a number";
+        int b = kind == TEXT_CARS ? 6 : 4; // the branch's field
+        if (n > b && strlen(fields[b]) >= NAME_LENGTH)
+            return "branch is too long";
+        rec->name = fields[k];
+        rec->text = fields[k + 1];
+        rec->branch = n > b ? fields[b] : "";
+        return NULL;
+    }
+
+    // The returned flag and the dates were added later; older files leave
+    // them unknown
+    Rental *r = &rec->rental;
+    if (n != 5 && n != 6 && n != 8)
+        return "expected id,customer,carId,days,cost[,isReturned[,from,until]]";
+    if (!parseIntField(fields[0], &r->rentalId) || r->rentalId <= 0)
+        return "rental ID is not a positive number";
+    if (fields[1][0] == '\0' || strlen(fields[1]) >= CUSTOMER_NAME_LENGTH)
+        return "customer name is empty or too long";
+    if (!parseIntField(fields[2], &r->carId))
+        return "car ID is not a number";
+    if (!parseIntField(fields[3], &r->days))
+        return "days is not a number";
+    if (!parseFloatField(fields[4], &r->totalCost))
+        return "cost is not a number";
+    r->isReturned = -1;
+    if (n > 5 && !parseIntField(fields[5], &r->isReturned))
+        return "isReturned is not a number";
+    if (n == 8)
+    {
+        r->startDay = parseDay(fields[6]);
+        r->endDay = parseDay(fields[7]);
+        if (r->startDay < 0 || r->endDay < 0)
+            r->startDay = r->endDay = 0; // "-" or a damaged date
+    }
+    rec->name = fields[1];
+    return NULL;
+}
+
+// Decimal integer fields; returns 0 unless all of s is one that fits.
+int parseIntField(const char *s, int *out)
+{
+    int negative = *s == '-';
+    s += negative;
+    if (!*s)
+        return 0;
+    long long v = 0;
+    for (; *s; s++)
+    {
+        if (*s < '0' || *s > '9' || v > 0x7fffffff)
+            return 0;
+        v = v * 10 + (*s - '0');
+    }
+    if (v > 0x7fffffffLL + negative)
+        return 0;
+    *out = negative ? -v : v;
+    return 1;
+}
+
+// Prices and costs as exported: digits with an optional fraction.
+int parseFloatField(const char *s, float *out)
+{
+    int negative = *s == '-', digits = 0;
+    s += negative;
+    double whole = 0, fraction = 0, scale = 1;
+    for (; *s >= '0' && *s <= '9'; s++, digits++)
+        whole = whole * 10 + (*s - '0');
+    if (*s == '.')
+        for (s++; *s >= '0' && *s <= '9'; s++, digits++)
+        {
+            fraction = fraction * 10 + (*s - '0');
+            scale *= 10;
+        }
+    if (*s || !digits)
+        return 0;
+    *out = (float)((whole + fraction / scale) * (negative ? -1 : 1));
+    return 1;
+}
+
+// --------------------------- Journal ---------------------------
+// Every change is appended to JOURNAL_FILE as one line in the same comma
+// format as the data files, prefixed with an operation tag:
+//   U,username,password,isAdmin              register_user
+//   A,id,brand,model,year,price,isAvailable,branch  addCar
+//   D,carId                                  deleteCar
+//   R,rentalId,customer,carId,days,cost,startDay  rentCar (day number)
+//   T,rentalId,cancelled                     returnCar (1 if it had not started)
+// The snapshot is only rewritten by checkpoint(), which then empties
+// the journal (unless other instances still read it; see Shared State).
+// IDs are never reused, so replay can skip records whose ID is already
+// present and a crash between saving the snapshot and truncating the
+// journal is harmless.
+
+void journalOpen()
+{
+    if (journalFd != -1)
+        return;
+    journalFd = open(JOURNAL_FILE, O_WRONLY | O_CREAT, 0644);
+    if (journalFd == -1)
+    {
+        printf("❌ Could not open %s, changes will only be saved on exit!\n", JOURNAL_FILE);
+        return;
+    }
+    if (!journalStarted && pthread_create(&journalThread, NULL, journalWriter, NULL) == 0)
+    {
+        pthread_detach(journalThread);
+        journalStarted = 1;
+    }
+}
+
+// Write out what is queued and stop journaling.
+void journalClose()
+{
+    pthread_mutex_lock(&journalLock);
+    journalFlushLocked();
+    if (journalFd != -1)
+        close(journalFd);
+    journalFd = -1;
+    pthread_mutex_unlock(&journalLock);
+}
+
+// Queue one record; it reaches the disk with the writer's next batch.
+void journalAppend(const char *fmt, ...)
+{
+    char line[COMMAND_LINE_LENGTH];
+    va_list ap;
+    va_start(ap, fmt);
+    int len = vsnprintf(line, sizeof(line) - 1, fmt, ap);
+    va_end(ap);
+    if (len > (int)sizeof(line) - 2)
+        len = sizeof(line) - 2;
+    line[len++] = '\n';
+    journalAppendText(line, len, 1);
+}
+
+// Queue whole lines holding records at once. Their bytes are claimed
+// right away, so records keep the order they were made in; with other
+// instances sharing the journal this happens under the shared lock, and
+// the others wait for the bytes to be written before they read them
+// (sharedAwaitWrites()).
+void journalAppendText(const char *text, size_t len, int records)
+{
+    pthread_mutex_lock(&journalLock);
+    if (journalFd != -1 && journalStarted)
+    {
+        long long at = journalOffset;
+        journalOffset += len;
+        if (shared)
+        {
+            __atomic_add_fetch(&shared->unwritten[sharedSlot], (long long)len, __ATOMIC_RELEASE);
+            __atomic_store_n(&shared->journalSize, journalOffset, __ATOMIC_RELEASE);
+        }
+        JournalRun *last = journalRunCount > 0 ? &journalRuns[journalRunCount - 1] : NULL;
+        if (last && last->offset + (long long)last->len == at)
+            last->len += len;
+        else
+        {
+            if (journalRunCount == journalRunCap)
+            {
+                journalRunCap = journalRunCap ? journalRunCap * 2 : 16;
+                journalRuns = xrealloc(journalRuns, journalRunCap * sizeof(JournalRun));
+            }
+            journalRuns[journalRunCount++] = (JournalRun){.offset = at, .len = len};
+        }
+        bufPrintf(&journalPending, "%.*s", (int)len, text);
+        journalLast = ++journalQueued;
+        pthread_cond_signal(&journalWork);
+    }
+    journalOps += records;
+    if (journalOps >= JOURNAL_CHECKPOINT_EVERY)
+        journalCheckpointDue = 1;
+    pthread_mutex_unlock(&journalLock);
+}
+
+// Called by each operation after it has released its locks, so that
+// threads waiting for the disk share the writer's fdatasync, and so that
+// a checkpoint that fell due does not hold up the operation's locks.
+void journalCommit()
+{
+    pthread_mutex_lock(&journalLock);
+    while (journalMode == JOURNAL_SYNC && journalSynced < journalLast)
+        pthread_cond_wait(&journalDurable, &journalLock);
+    int due = journalCheckpointDue;
+    pthread_mutex_unlock(&journalLock);
+    if (!due)
+        return;
+
+    // Whoever gets the locks first takes it; the rest find it done
+    sharedLock();
+    pthread_rwlock_wrlock(&storeLock);
+    if (__atomic_load_n(&journalCheckpointDue, __ATOMIC_ACQUIRE))
+        checkpoint();
+    pthread_rwlock_unlock(&storeLock);
+    sharedUnlock();
+}
+
+// Wait until everything queued is on disk; journalLock is held.
+void journalFlushLocked()
+{
+    while (journalSynced < journalQueued)
+        pthread_cond_wait(&journalDurable, &journalLock);
+}
+
+void *journalWriter(void *arg)
+{
+    (void)arg;
+    OutBuf batch = {0};
+    JournalRun *runs = NULL;
+    int runCap = 0;
+    pthread_mutex_lock(&journalLock);
+    for (;;)
+    {
+        while (journalPending.len == 0)
+            pthread_cond_wait(&journalWork, &journalLock);
+
+        // Take the whole queue; appends go on into the other buffers
+        OutBuf next = batch;
+        batch = journalPending;
+        journalPending = next;
+        journalPending.len = 0;
+        JournalRun *nextRuns = runs;
+        int nextCap = runCap, runCount = journalRunCount;
+        runs = journalRuns;
+        runCap = journalRunCap;
+        journalRuns = nextRuns;
+        journalRunCap = nextCap;
+        journalRunCount = 0;
+        long long last = journalQueued;
+        int fd = journalFd;
+        pthread_mutex_unlock(&journalLock);
+
+        long long t0 = nowNanos();
+        int ok = 1;
+        size_t pos = 0;
+        for (int i = 0; i < runCount; i++)
+        {
+            size_t done = 0;
+            ssize_t n = 0;
+            while (done < runs[i].len && (n = pwrite(fd, batch.data + pos + done, runs[i].len - done, runs[i].offset + done)) > 0)
+                done += n;
+            ok = ok && done == runs[i].len;
+            pos += runs[i].len;
+        }
+        if (shared)
+            __atomic_sub_fetch(&shared->unwritten[sharedSlot], (long long)batch.len, __ATOMIC_RELEASE);
+        ok = ok && fdatasync(fd) == 0;
+        if (!ok)
+            printf("❌ Could not write %s!\n", JOURNAL_FILE);
+        metricRecord(METRIC_JOURNAL_SYNC, t0, ok);
+        batch.len = 0;
+
+        pthread_mutex_lock(&journalLock);
+        journalSynced = last;
+        pthread_cond_broadcast(&journalDurable);
+    }
+    return NULL;
+}
+
+// Apply the records from byte from up to byte to (-1: the end of the
+// file) on top of the tables, and move journalOffset past them. Other
+// instances' records are applied the same way while running.
+void journalReplay(long long from, long long to)
+{
+    FILE *fp = fopen(JOURNAL_FILE, "r");
+    if (!fp)
+        return;
+    if (fseek(fp, from, SEEK_SET) != 0)
+    {
+        fclose(fp);
+        return;
+    }
+
+    // One record per line. A line that does not parse is skipped on its
+    // own; only a last line without its newline (torn by a crash
+    // mid-append) ends the replay.
+    char *line = NULL;
+    size_t lineCap = 0;
+    ssize_t len;
+    int torn = 0;
+    journalOffset = from;
+    while ((to < 0 || journalOffset < to) && (len = getline(&line, &lineCap, fp)) > 0)
+    {
+        if (line[len - 1] != '\n')
+        {
+            torn = 1;
+            break;
+        }
+        journalOffset += len;
+
+        User u = {0};
+        Car c = {0};
+        Rental r = {0};
+        char type, brand[NAME_LENGTH], model[NAME_LENGTH], branch[NAME_LENGTH], name[CUSTOMER_NAME_LENGTH];
+        int id, index, slot, n = -1, ok = 1;
+        // Bytes claimed by an instance that died before writing them read
+        // as zeros in front of the next record
+        const char *rec = line;
+        while (rec < line + len && *rec == '\0')
+            rec++;
+        if (rec[strspn(rec, " \t\r\n")] == '\0')
+            continue;
+        if (sscanf(rec, " %c,%n", &type, &n) != 1 || n < 0)
+            type = '?';
+        const char *p = rec + (n < 0 ? 0 : n);
+
+        switch (type)
+        {
+        case 'U':
+            if (!(ok = sscanf(p, "%29[^,],%127[^,],%d", u.username, u.password, &u.isAdmin) == 3))
+                break;
+            if (findUserIndex(u.username) == -1)
+            {
+                *(User *)tableAppend(&userTable) = u;
+                userHashInsert(userTable.count - 1);
+                dictIntern(&customerDict, u.username);
+            }
+            break;
+        case 'A':
+            if (!(ok = sscanf(p, "%d,%29[^,],%29[^,],%d,%f,%d,%29[^\r\n]", &c.id, brand, model, &c.year, &c.pricePerDay, &c.isAvailable, branch) == 7))
+                break;
+            c.brand = brandIntern(brand);
+            c.model = dictIntern(&modelDict, model);
+            c.branch = branchIntern(branch);
+            if (c.id >= nextCarId)
+                nextCarId = c.id + 1;
+            if (findCarIndex(c.id) == -1)
+                insertCar(&c);
+            break;
+        case 'D':
+            if (!(ok = sscanf(p, "%d", &id) == 1))
+                break;
+            if ((index = findCarIndex(id)) != -1)
+                removeCarAt(index);
+            break;
+        case 'R':
+            if (!(ok = sscanf(p, "%d,%49[^,],%d,%d,%f,%d", &r.rentalId, name, &r.carId, &r.days, &r.totalCost, &r.startDay) == 6))
+                break;
+            r.customer = dictIntern(&customerDict, name);
+            r.endDay = r.startDay + r.days;
+            if (r.rentalId >= nextRentalId)
+                nextRentalId = r.rentalId + 1;
+            if (findRentalIndex(r.rentalId) != -1)
+                break;
+            index = findCarIndex(r.carId);
+            *(Rental *)tableAppend(&rentalTable) = r;
+            slot = rentalTable.count - 1;
+            idMapSet(&rentalSlotById, r.rentalId, slot);
+            customerRentalAdd(slot);
+            statsRentalAdded(slot, index);
+            if (index != -1)
+            {
+                // Booked as doRentCar() does (at startup the bookings are
+                // rebuilt afterwards anyway)
+                bookingAdd(carBookings(index), r.startDay, r.endDay, slot);
+                setCarAvailable(index, !bookingCovers(carBookings(index), today()));
+            }
+            break;
+        case 'T':
+        {
+            int cancelled;
+            if (!(ok = sscanf(p, "%d,%d", &id, &cancelled) == 2))
+                break;
+            if ((slot = findRentalIndex(id)) == -1 || rentalAt(slot)->isReturned == 1)
+                break;
+            rentalAt(slot)->isReturned = 1;
+            index = findCarIndex(rentalAt(slot)->carId);
+            if (cancelled)
+                statsRentalCancelled(slot, index);
+            if (index != -1)
+            {
+                bookingRemove(carBookings(index), slot);
+                setCarAvailable(index, !bookingCovers(carBookings(index), today()));
+            }
+            break;
+        }
+        default:
+            ok = 0;
+        }
+        if (ok)
+            journalOps++;
+        else
+            printf("❌ %s: skipping damaged record after %d entries.\n", JOURNAL_FILE, journalOps);
+    }
+    free(line);
+    fclose(fp);
+    if (!torn)
+        return;
+
+    // A torn last line from a crash mid-append; everything before it is kept.
+    printf("❌ %s: ignoring damaged record after %d entries.\n", JOURNAL_FILE, journalOps);
+    if (to >= 0)
+        journalOffset = to; // skipped, or every instance would trip on it again
+    checkpoint();
+}
+
+// Fold the journal into the snapshot and start a fresh journal. Queued
+// records are written first, and appends wait until the journal is reset.
+// While other instances run they may not have read the journal yet, so it
+// is kept and the snapshot records how much of it it holds. The caller
+// holds the shared lock.
+void checkpoint()
+{
+    pthread_mutex_lock(&journalLock);
+    journalFlushLocked();
+    int alone = sharedAlone();
+    if (alone)
+        journalOffset = 0;
+    saveData();
+
+    if (alone)
+    {
+        int fd = journalFd != -1 ? journalFd : open(JOURNAL_FILE, O_WRONLY | O_CREAT, 0644);
+        if (fd == -1 || ftruncate(fd, 0) != 0)
+            printf("❌ Could not reset %s!\n", JOURNAL_FILE);
+        if (fd != -1 && fd != journalFd)
+            close(fd);
+        if (shared)
+            __atomic_store_n(&shared->journalSize, 0, __ATOMIC_RELEASE);
+    }
+    journalOps = 0;
+    journalCheckpointDue = 0;
+    pthread_mutex_unlock(&journalLock);
+}
+
+// --------------------------- Shared State ---------------------------
+// Instances started in the same directory work on one store. The tables
+// hold pointers into each process's own memory, so every instance keeps
+// its own copy and the journal is what they share:
+//   - a change is made under the shared lock, after catching up with the
+//     records the other instances have appended (sharedBegin()), and its
+//     record claims its place in the journal before the lock is released;
+//     an instance on its own, with nothing to catch up on, skips the lock,
+//     and one that joins waits for those changes to finish;
+//     the writer thread fills it in later, and whoever reads that part of
+//     the journal first waits for it (sharedAwaitWrites());
+//   - readers catch up first (sharedSync()), so each sees every change
+//     that had finished when it started;
+//   - the journal is only emptied, and rentals only archived, by an
+//     instance that is on its own; until then snapshots record how much
+//     of the journal they hold (journalOffset).
+// The lock is a robust mutex: if an instance dies holding it, the next one
+// to lock it forgets the bytes it claimed at the end of the journal and
+// never wrote.
+// Without shared memory an instance runs on its own, as before.
+
+void sharedOpen()
+{
+    char cwd[4096];
+    if (!getcwd(cwd, sizeof(cwd)))
+        return;
+    snprintf(sharedName, sizeof(sharedName), SHARED_NAME_FORMAT, hashString(cwd));
+
+    // The object may be removed by the last instance leaving just as this
+    // one opens it; then it is opened again, or created anew
+    int tries = 0;
+    while (!sharedAttach() && ++tries < 100)
+        usleep(1000);
+    if (tries == 100)
+        printf("❌ Could not open shared state, running on its own!\n");
+}
+
+// One try at opening the shared state and joining its instances. Returns
+// 0 if it was closed meanwhile and the caller should try again, 1 if this
+// instance joined or runs on its own.
+int sharedAttach()
+{
+    int created = 1;
+    int fd = shm_open(sharedName, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd == -1 && errno == EEXIST)
+    {
+        created = 0;
+        fd = shm_open(sharedName, O_RDWR, 0600);
+        if (fd == -1 && errno == ENOENT)
+            return 0;
+    }
+    if (fd == -1 || (created && ftruncate(fd, sizeof(SharedState)) != 0))
+    {
+        printf("❌ Could not open shared state, running on its own!\n");
+        if (fd != -1)
+            close(fd);
+        return 1;
+    }
+
+    // The creator sizes and sets it up; the others wait for the magic
+    struct stat st;
+    for (int tries = 0; !created && tries < 100; tries++)
+    {
+        if (fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(SharedState))
+            break;
+        usleep(10000);
+    }
+    SharedState *s = fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(SharedState)
+                         ? mmap(NULL, sizeof(SharedState), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)
+                         : MAP_FAILED;
+    close(fd);
+    if (s == MAP_FAILED)
+    {
+        printf("❌ Could not open shared state, running on its own!\n");
+        return 1;
+    }
+
+    if (created)
+    {
+        pthread_mutexattr_t attr;
+        pthread_mutexattr_init(&attr);
+        pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+        pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+        pthread_mutex_init(&s->lock, &attr);
+        pthread_mutexattr_destroy(&attr);
+        s->journalSize = 0;
+        s->instances = 0;
+        __atomic_store_n(&s->magic, SHARED_MAGIC, __ATOMIC_RELEASE);
+    }
+    for (int tries = 0; __atomic_load_n(&s->magic, __ATOMIC_ACQUIRE) == 0 && tries < 100; tries++)
+        usleep(10000);
+    if (s->magic != SHARED_MAGIC)
+    {
+        int closed = s->magic == SHARED_CLOSED;
+        if (!closed)
+            printf("❌ Shared state %s is from another version, running on its own!\n", sharedName);
+        munmap(s, sizeof(SharedState));
+        return !closed;
+    }
+
+    shared = s;
+    sharedLock();
+    if (shared->magic == SHARED_CLOSED)
+    {
+        sharedUnlock();
+        munmap(s, sizeof(SharedState));
+        shared = NULL;
+        return 0;
+    }
+    sharedAlone(); // clears out instances that are gone
+    int i = 0;
+    while (i < SHARED_MAX_INSTANCES && shared->pids[i] != 0)
+        i++;
+    if (i < SHARED_MAX_INSTANCES)
+    {
+        shared->pids[i] = getpid();
+        shared->starts[i] = processStart(getpid());
+        shared->unwritten[i] = 0;
+        shared->lockless[i] = 0;
+        sharedSlot = i;
+        // Changes made without the lock must finish before this instance
+        // reads the journal
+        __atomic_add_fetch(&shared->instances, 1, __ATOMIC_SEQ_CST);
+        sharedAwaitLockless();
+    }
+    sharedUnlock();
+    if (i == SHARED_MAX_INSTANCES)
+    {
+        printf("❌ Too many instances, running on its own!\n");
+        munmap(s, sizeof(SharedState));
+        shared = NULL;
+    }
+    return 1;
+}
+
+// Leave the registry. The last instance to leave removes the shared
+// memory, marking it closed first for any instance that opened it just
+// before.
+void sharedClose()
+{
+    if (!shared)
+        return;
+    sharedLock();
+    shared->pids[sharedSlot] = 0;
+    __atomic_sub_fetch(&shared->instances, 1, __ATOMIC_SEQ_CST);
+    if (sharedAlone())
+    {
+        __atomic_store_n(&shared->magic, SHARED_CLOSED, __ATOMIC_RELEASE);
+        shm_unlink(sharedName);
+    }
+    sharedUnlock();
+    munmap(shared, sizeof(SharedState));
+    shared = NULL;
+    sharedSlot = -1;
+}
+
+void sharedLock()
+{
+    if (!shared || pthread_mutex_lock(&shared->lock) != EOWNERDEAD)
+        return;
+
+    // Its owner died: forget the bytes it claimed at the end of the journal
+    // and never wrote (or the journal it died emptying), unless this
+    // instance's own records still wait to go after them
+    pthread_mutex_consistent(&shared->lock);
+    sharedAwaitWrites();
+    struct stat st;
+    if (stat(JOURNAL_FILE, &st) == 0 && st.st_size < shared->journalSize &&
+        (sharedSlot == -1 || __atomic_load_n(&shared->unwritten[sharedSlot], __ATOMIC_ACQUIRE) == 0))
+        shared->journalSize = st.st_size;
+}
+
+void sharedUnlock()
+{
+    if (shared)
+        pthread_mutex_unlock(&shared->lock);
+}
+
+// Take the shared lock for a change and apply the other instances' records
+// first. Call before storeLock: the order is always shared, then store.
+// An instance on its own that has every record already needs neither; it
+// only counts the change in lockless, which an instance joining waits on.
+void sharedBegin()
+{
+    availabilityRefresh();
+    if (!shared)
+        return;
+    __atomic_add_fetch(&shared->lockless[sharedSlot], 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&shared->instances, __ATOMIC_SEQ_CST) == 1 &&
+        __atomic_load_n(&shared->journalSize, __ATOMIC_ACQUIRE) == __atomic_load_n(&journalOffset, __ATOMIC_ACQUIRE))
+    {
+        sharedHeld = 0;
+        return;
+    }
+    __atomic_sub_fetch(&shared->lockless[sharedSlot], 1, __ATOMIC_SEQ_CST);
+
+    sharedHeld = 1;
+    sharedLock();
+    if (__atomic_load_n(&shared->journalSize, __ATOMIC_ACQUIRE) != journalOffset)
+    {
+        sharedAwaitWrites();
+        // Read under storeLock, so this instance's own changes are not
+        // half way through claiming their bytes
+        pthread_rwlock_wrlock(&storeLock);
+        long long size = shared->journalSize;
+        if (journalOffset > size)
+            journalOffset = 0; // emptied under us by a dead instance
+        journalReplay(journalOffset, size);
+        pthread_rwlock_unlock(&storeLock);
+    }
+}
+
+void sharedEnd()
+{
+    if (!shared)
+        return;
+    if (sharedHeld)
+        sharedUnlock();
+    else
+        __atomic_sub_fetch(&shared->lockless[sharedSlot], 1, __ATOMIC_SEQ_CST);
+}
+
+// Catch up with the other instances (and the date) before reading.
+void sharedSync()
+{
+    availabilityRefresh();
+    if (!shared || __atomic_load_n(&shared->journalSize, __ATOMIC_ACQUIRE) == journalOffset)
+        return;
+    sharedBegin();
+    sharedEnd();
+}
+
+// 1 if no other instance is running; the shared lock is held. Instances
+// that died without leaving are cleared out on the way.
+int sharedAlone()
+{
+    if (!shared)
+        return 1;
+    int others = 0;
+    for (int i = 0; i < SHARED_MAX_INSTANCES; i++)
+    {
+        pid_t pid = shared->pids[i];
+        if (pid == 0 || pid == getpid())
+            continue;
+        if ((kill(pid, 0) != 0 && errno == ESRCH) || processStart(pid) != shared->starts[i])
+        {
+            shared->pids[i] = 0;
+            shared->unwritten[i] = 0; // a hole in the journal; replay skips it
+            shared->lockless[i] = 0;
+            __atomic_sub_fetch(&shared->instances, 1, __ATOMIC_SEQ_CST);
+        }
+        else
+            others++;
+    }
+    return others == 0;
+}
+
+// Wait until the other instances' writers have written every byte they
+// claimed; the shared lock is held, so no more are claimed meanwhile.
+// An instance that died first leaves its bytes unwritten, so the running
+// ones are checked now and then.
+void sharedAwaitWrites()
+{
+    for (int tries = 1;; tries++)
+    {
+        int busy = 0;
+        for (int i = 0; i < SHARED_MAX_INSTANCES && !busy; i++)
+            busy = i != sharedSlot && __atomic_load_n(&shared->unwritten[i], __ATOMIC_ACQUIRE) > 0;
+        if (!busy)
+            return;
+        if (tries % 1000 == 0)
+            sharedAlone();
+        usleep(100);
+    }
+}
+
+// Wait until the other instances have finished the changes they began on
+// their own, without the lock; the shared lock is held and this
+// instance is listed, so they begin no more.
+void sharedAwaitLockless()
+{
+    for (int tries = 1;; tries++)
+    {
+        int busy = 0;
+        for (int i = 0; i < SHARED_MAX_INSTANCES && !busy; i++)
+            busy = i != sharedSlot && __atomic_load_n(&shared->lockless[i], __ATOMIC_SEQ_CST) > 0;
+        if (!busy)
+            return;
+        if (tries % 1000 == 0)
+            sharedAlone();
+        usleep(100);
+    }
+}
+
+// When process pid started, in clock ticks after boot (field 22 of
+// /proc/<pid>/stat), or 0 if that cannot be read.
+unsigned long long processStart(pid_t pid)
+{
+    char path[64], line[1024];
+    snprintf(path, sizeof(path), "/proc/%d/stat", (int)pid);
+    FILE *fp = fopen(path, "r");
+    if (!fp)
+        return 0;
+    size_t len = fread(line, 1, sizeof(line) - 1, fp);
+    fclose(fp);
+    line[len] = '\0';
+
+    // The command name (field 2) may hold spaces; count from its ')'
+    char *p = strrchr(line, ')');
+    unsigned long long start = 0;
+    for (int field = 2; p && field < 22; field++)
+        p = strchr(p + 1, ' ');
+    if (p && sscanf(p + 1, "%llu", &start) != 1)
+        start = 0;
+    return start;
+}
+
+// --------------------------- Sorted Indexes ---------------------------
+int compareId(const Car *a, const Car *b)
+{
+    return (a->id > b->id) - (a->id < b->id);
+}
+
+int compareBrand(const Car *a, const Car *b)
+{
+    int c = dictCompare(&brandDict, a->brand, b->brand);
+    return c ? c : compareId(a, b);
+}
+
+int compareModel(const Car *a, const Car *b)
+{
+    int c = dictCompare(&modelDict, a->model, b->model);
+    return c ? c : compareId(a, b);
+}
+
+int compareYear(const Car *a, const Car *b)
+{
+    int c = (a->year > b->year) - (a->year < b->year);
+    return c ? c : compareId(a, b);
+}
+
+int comparePrice(const Car *a, const Car *b)
+{
+    int c = (a->pricePerDay > b->pricePerDay) - (a->pricePerDay < b->pricePerDay);
+    return c ? c : compareId(a, b);
+}
+
+int compareStatus(const Car *a, const Car *b)
+{
+    int c = b->isAvailable - a->isAvailable; // Available first
+    return c ? c : compareId(a, b);
+}
+
+int skipRandomLevel()
+{
+    static unsigned int state = 2463534242u;
+    int level = 1;
+    for (;;)
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        if (level >= SKIP_MAX_LEVEL || (state & 3))
+            return level;
+        level++;
+    }
+}
+
+SkipNode *skipNewNode(SkipList *list, int level)
+{
+    SkipNode *n = list->freeNodes[level];
+    if (n)
+        list->freeNodes[level] = n->next[0].node;
+    else
+        n = arenaAlloc(&storeArena, sizeof(SkipNode) + level * sizeof(SkipLink));
+    n->level = level;
+    memset(n->next, 0, level * sizeof(SkipLink));
+    return n;
+}
+
+// Fill update[] with the last node before key's position on every level,
+// and rank[] with that node's position (the head is position 0).
+void skipFind(SkipList *list, const Car *key, SkipNode **update, int *rank)
+{
+    if (!list->head)
+    {
+        list->head = skipNewNode(list, SKIP_MAX_LEVEL);
+        list->head->slot = -1;
+        list->level = 1;
+    }
+
+    SkipNode *x = list->head;
+    for (int lv = list->level - 1; lv >= 0; lv--)
+    {
+        rank[lv] = lv == list->level - 1 ? 0 : rank[lv + 1];
+        while (x->next[lv].node && list->cmp(carAt(x->next[lv].node->slot), key) < 0)
+        {
+            rank[lv] += x->next[lv].span;
+            x = x->next[lv].node;
+        }
+        update[lv] = x;
+    }
+}
+
+void skipInsert(SkipList *list, int slot)
+{
+    SkipNode *update[SKIP_MAX_LEVEL];
+    int rank[SKIP_MAX_LEVEL];
+    skipFind(list, carAt(slot), update, rank);
+
+    int level = skipRandomLevel();
+    for (int lv = list->level; lv < level; lv++)
+    {
+        rank[lv] = 0;
+        update[lv] = list->head;
+        update[lv]->next[lv].span = list->length;
+    }
+    if (level > list->level)
+        list->level = level;
+
+    SkipNode *n = skipNewNode(list, level);
+    n->slot = slot;
+    for (int lv = 0; lv < level; lv++)
+    {
+        n->next[lv].node = update[lv]->next[lv].node;
+        update[lv]->next[lv].node = n;
+        n->next[lv].span = update[lv]->next[lv].span - (rank[0] - rank[lv]);
+        update[lv]->next[lv].span = rank[0] - rank[lv] + 1;
+    }
+    for (int lv = level; lv < list->level; lv++)
+        update[lv]->next[lv].span++;
+    list->length++;
+}
+
+// Must be called while the car still has the key it was inserted with.
+void skipRemove(SkipList *list, int slot)
+{
+    SkipNode *update[SKIP_MAX_LEVEL];
+    int rank[SKIP_MAX_LEVEL];
+    skipFind(list, carAt(slot), update, rank);
+
+    SkipNode *n = update[0]->next[0].node;
+    if (!n || n->slot != slot)
+        return;
+    for (int lv = 0; lv < list->level; lv++)
+    {
+        if (update[lv]->next[lv].node == n)
+        {
+            update[lv]->next[lv].span += n->next[lv].span - 1;
+            update[lv]->next[lv].node = n->next[lv].node;
+        }
+        else
+            update[lv]->next[lv].span--;
+    }
+    while (list->level > 1 && !list->head->next[list->level - 1].node)
+        list->level--;
+    list->length--;
+
+    n->next[0].node = list->freeNodes[n->level];
+    list->freeNodes[n->level] = n;
+}
+
+// The node at 0-based position offset, or NULL past the end.
+SkipNode *skipSeek(SkipList *list, int offset)
+{
+    if (!list->head || offset < 0 || offset >= list->length)
+        return NULL;
+
+    SkipNode *x = list->head;
+    int pos = 0;
+    for (int lv = list->level - 1; lv >= 0; lv--)
+    {
+        while (x->next[lv].node && pos + x->next[lv].span <= offset + 1)
+        {
+            pos += x->next[lv].span;
+            x = x->next[lv].node;
+        }
+        if (pos == offset + 1)
+            return x;
+    }
+    return NULL;
+}
+
+CarCompare buildCompare;
+
+int compareSlots(const void *a, const void *b)
+{
+    return buildCompare(carAt(*(const int *)a), carAt(*(const int *)b));
+}
+
+// Bulk-load an empty list: sort once, then link every level in a single
+// pass instead of searching for each insert.
+void skipBuild(SkipList *list, int *slots, int count)
+{
+    SkipNode *update[SKIP_MAX_LEVEL];
+    int rank[SKIP_MAX_LEVEL];
+    skipFind(list, NULL, update, rank); // creates the head; the list is empty so no compares
+
+    buildCompare = list->cmp;
+    qsort(slots, count, sizeof(int), compareSlots);
+
+    SkipNode *last[SKIP_MAX_LEVEL];
+    int lastPos[SKIP_MAX_LEVEL];
+    for (int lv = 0; lv < SKIP_MAX_LEVEL; lv++)
+    {
+        last[lv] = list->head;
+        lastPos[lv] = 0;
+    }
+    for (int i = 0; i < count; i++)
+    {
+        int level = skipRandomLevel();
+        if (level > list->level)
+            list->level = level;
+        SkipNode *n = skipNewNode(list, level);
+        n->slot = slots[i];
+        for (int lv = 0; lv < level; lv++)
+        {
+            last[lv]->next[lv].node = n;
+            last[lv]->next[lv].span = i + 1 - lastPos[lv];
+            last[lv] = n;
+            lastPos[lv] = i + 1;
+        }
+    }
+    for (int lv = 0; lv < SKIP_MAX_LEVEL; lv++)
+        last[lv]->next[lv].span = count - lastPos[lv];
+    list->length = count;
+}
+
+void carIndexAdd(int slot)
+{
+    for (int i = 0; i < CAR_INDEX_COUNT; i++)
+        skipInsert(carIndexes[i], slot);
+    shardAdd(slot);
+    carNameAdd(slot);
+}
+
+void carIndexRemove(int slot)
+{
+    for (int i = 0; i < CAR_INDEX_COUNT; i++)
+        skipRemove(carIndexes[i], slot);
+    shardRemove(slot);
+    carNameRemove(slot);
+}
+
+// The indexes are not persisted; they are rebuilt from the cars at startup.
+void carIndexRebuild()
+{
+    for (int i = 0; i < CAR_INDEX_COUNT; i++)
+    {
+        SkipList *list = carIndexes[i];
+        if (!list->head)
+            continue;
+
+        // Recycle the old nodes rather than leaking them into the arena
+        SkipNode *n = list->head->next[0].node;
+        while (n)
+        {
+            SkipNode *next = n->next[0].node;
+            n->next[0].node = list->freeNodes[n->level];
+            list->freeNodes[n->level] = n;
+            n = next;
+        }
+        memset(list->head->next, 0, SKIP_MAX_LEVEL * sizeof(SkipLink));
+        list->level = 1;
+        list->length = 0;
+    }
+
+    IntVec slots = {0};
+    for (int i = 0; i < carTable.count; i++)
+        if (carAt(i)->id)
+            intVecPush(&slots, i);
+    for (int i = 0; i < CAR_INDEX_COUNT; i++)
+        skipBuild(carIndexes[i], slots.items, slots.count);
+    free(slots.items);
+    shardsRebuild();
+    carNameRebuild();
+}
+
+void printCarRow(OutBuf *out, const Car *c)
+{
+    bufPrintf(out, "%-8d %-15s %-15s %-12s %-6d %10.02f %9s\n",
+           c->id, carBrand(c), carModel(c), carBranch(c), c->year, c->pricePerDay,
+           c->isAvailable ? "Available" : "Rented");
+}
+
+// --------------------------- Columnar Search ---------------------------
+int brandFind(const char *brand)
+{
+    return dictFind(&brandDict, brand);
+}
+
+// Brand ids come from here, so every brand has its totals entry.
+int brandIntern(const char *brand)
+{
+    int id = dictIntern(&brandDict, brand);
+    while (brandTable.count <= id)
+        tableAppend(&brandTable);
+    return id;
+}
+
+// Copy car slot into row of the columns, growing them to cover it; slot
+// -1 (or a deleted car) leaves a free row.
+void carColumnsSet(CarColumns *c, int row, int slot)
+{
+    if (row >= c->cap)
+    {
+        int cap = c->cap ? c->cap : SEARCH_BLOCK;
+        while (cap <= row)
+            cap *= 2;
+        c->price = xrealloc(c->price, cap * sizeof(float));
+        c->year = xrealloc(c->year, cap * sizeof(int));
+        c->brand = xrealloc(c->brand, cap * sizeof(int));
+        c->status = xrealloc(c->status, cap * sizeof(int));
+        c->slot = xrealloc(c->slot, cap * sizeof(int));
+        // The kernel reads whole vectors past count; rows there never match
+        for (int i = c->cap; i < cap; i++)
+        {
+            c->price[i] = 0;
+            c->year[i] = 0;
+            c->brand[i] = -1;
+            c->status[i] = CAR_STATUS_DELETED;
+            c->slot[i] = -1;
+        }
+        c->cap = cap;
+    }
+    for (; c->count <= row; c->count++)
+        c->status[c->count] = CAR_STATUS_DELETED;
+
+    const Car *car = slot != -1 ? carAt(slot) : NULL;
+    c->slot[row] = slot;
+    if (!car || !car->id)
+    {
+        c->brand[row] = -1;
+        c->status[row] = CAR_STATUS_DELETED;
+        return;
+    }
+    c->price[row] = car->pricePerDay;
+    c->year[row] = car->year;
+    c->brand[row] = car->brand;
+    c->status[row] = car->isAvailable ? CAR_STATUS_AVAILABLE : CAR_STATUS_RENTED;
+}
+
+// Filter count rows from start and write the matching cars' slots to
+// hits. Predicates are evaluated SEARCH_LANES rows at a time with vector
+// compares (each lane ends up -1 on a match, 0 otherwise), then the
+// matches are packed without branching on them. start is a multiple of
+// SEARCH_BLOCK and so is the columns' capacity, so the last partial vector
+// stays in bounds.
+int searchBlock(const CarColumns *c, const CarQuery *q, int brandId, int start, int count, int *hits)
+{
+    SearchFloats minPrice = (SearchFloats){0} + q->minPrice;
+    SearchFloats maxPrice = (SearchFloats){0} + (q->maxPrice > 0 ? q->maxPrice : 3.4e38f);
+    SearchInts minYear = (SearchInts){0} + q->minYear;
+    SearchInts minStatus = (SearchInts){0} + (q->availableOnly ? CAR_STATUS_AVAILABLE : CAR_STATUS_RENTED);
+    SearchInts brand = (SearchInts){0} + brandId;
+    SearchInts anyBrand = (SearchInts){0} - (brandId < 0);
+
+    int match[SEARCH_BLOCK];
+    for (int i = 0; i < count; i += SEARCH_LANES)
+    {
+        SearchFloats p;
+        SearchInts y, b, st;
+        memcpy(&p, c->price + start + i, sizeof(p));
+        memcpy(&y, c->year + start + i, sizeof(y));
+        memcpy(&b, c->brand + start + i, sizeof(b));
+        memcpy(&st, c->status + start + i, sizeof(st));
+        SearchInts m = (p >= minPrice) & (p <= maxPrice) & (y >= minYear) & (st >= minStatus) & ((b == brand) | anyBrand);
+        memcpy(match + i, &m, sizeof(m));
+    }
+
+    int found = 0;
+    for (int i = 0; i < count; i++)
+    {
+        hits[found] = c->slot[start + i];
+        found -= match[i];
+    }
+    return found;
+}
+
+// --------------------------- Branch Shards ---------------------------
+// The fleet's search columns are partitioned by branch; rentals, their
+// locks and the journal are not. A car's branch never changes, so
+// its shard is fixed; only its row within the shard is looked up (carRows).
+// Shards are created with their branch, under the write lock, so scans
+// only need the read lock plus each shard's own lock in turn.
+int branchFind(const char *branch)
+{
+    return dictFind(&branchDict, branch[0] ? branch : BRANCH_DEFAULT);
+}
+
+// Branch ids come from here, so every branch has its totals and shard.
+int branchIntern(const char *branch)
+{
+    int id = dictIntern(&branchDict, branch[0] ? branch : BRANCH_DEFAULT);
+    while (branchTable.count <= id)
+        tableAppend(&branchTable);
+    while (shardTable.count <= id)
+        tableAppend(&shardTable); // zeroed, which is an unlocked mutex
+    return id;
+}
+
+pthread_mutex_t *carShardLock(int slot)
+{
+    return &shardAt(carAt(slot)->branch)->lock;
+}
+
+// Give a new car a row in its branch's shard.
+void shardAdd(int slot)
+{
+    Shard *s = shardAt(carAt(slot)->branch);
+    int row = s->freeRows.count > 0 ? s->freeRows.items[--s->freeRows.count] : s->columns.count;
+    while (carRows.count <= slot)
+        intVecPush(&carRows, -1);
+    carRows.items[slot] = row;
+    carColumnsSet(&s->columns, row, slot);
+}
+
+// Called while the car is still in its slot.
+void shardRemove(int slot)
+{
+    Shard *s = shardAt(carAt(slot)->branch);
+    int row = carRows.items[slot];
+    carColumnsSet(&s->columns, row, -1);
+    intVecPush(&s->freeRows, row);
+    carRows.items[slot] = -1;
+}
+
+// Copy a changed status into the car's row.
+void shardUpdate(int slot)
+{
+    carColumnsSet(&shardAt(carAt(slot)->branch)->columns, carRows.items[slot], slot);
+}
+
+// The shards are not persisted; like the skip lists they are rebuilt from
+// the cars at startup, each branch's cars in slot order.
+void shardsRebuild()
+{
+    for (int i = 0; i < shardTable.count; i++)
+    {
+        shardAt(i)->columns.count = 0;
+        shardAt(i)->freeRows.count = 0;
+    }
+    for (int i = 0; i < branchDict.names.count; i++)
+        branchIntern(dictName(&branchDict, i));
+    intVecResize(&carRows, 0);
+    for (int i = 0; i < carTable.count; i++)
+        if (carAt(i)->id)
+            shardAdd(i);
+}
+
+void *shardScanPart(void *arg)
+{
+    ShardScan *scan = arg;
+    int block[SEARCH_BLOCK];
+    int first = scan->branch == -1 ? 0 : scan->branch;
+    int last = scan->branch == -1 ? shardTable.count : scan->branch + 1;
+    for (int b = first; b < last; b++)
+    {
+        Shard *s = shardAt(b);
+        pthread_mutex_lock(&s->lock);
+        const CarColumns *c = &s->columns;
+        int blocks = (c->count + SEARCH_BLOCK - 1) / SEARCH_BLOCK;
+        int from = (int)((long long)blocks * scan->part / scan->parts) * SEARCH_BLOCK;
+        int to = (int)((long long)blocks * (scan->part + 1) / scan->parts) * SEARCH_BLOCK;
+        if (to > c->count)
+            to = c->count;
+        for (int start = from; start < to && scan->query; start += SEARCH_BLOCK)
+        {
+            int n = to - start < SEARCH_BLOCK ? to - start : SEARCH_BLOCK;
+            int found = searchBlock(c, scan->query, scan->brandId, start, n, block);
+            for (int i = 0; i < found; i++)
+                intVecPush(&scan->hits, block[i]);
+        }
+        for (int row = from; row < to && scan->heap.limit; row++)
+            if (c->status[row] == CAR_STATUS_AVAILABLE)
+                topPush(&scan->heap, topEntry(scan->topKind, c->slot[row]));
+        for (int row = from; row < to && !scan->query && !scan->heap.limit; row++)
+            if (c->status[row] != CAR_STATUS_DELETED && !bookingConflict(carBookings(c->slot[row]), scan->startDay, scan->endDay))
+                intVecPush(&scan->hits, c->slot[row]);
+        pthread_mutex_unlock(&s->lock);
+    }
+    return NULL;
+}
+
+// Run scan over its shards and put the slots found in hits, unordered
+// (a top-K scan leaves them in scan->heap instead). Small scans run on
+// this thread; large ones are split between threads, each taking its part
+// of every shard, and their hits or heaps are joined. The caller holds
+// the read lock.
+void shardScan(ShardScan *scan, IntVec *hits)
+{
+    int cars = scan->branch == -1 ? fleetStats.cars : branchAt(scan->branch)->cars;
+    int threads = 1;
+    if (cars >= SHARD_PARALLEL_MIN)
+    {
+        threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+        if (threads > SHARD_SCAN_THREADS)
+            threads = SHARD_SCAN_THREADS;
+        if (threads < 1)
+            threads = 1;
+    }
+
+    ShardScan parts[SHARD_SCAN_THREADS];
+    pthread_t tids[SHARD_SCAN_THREADS];
+    int started[SHARD_SCAN_THREADS] = {0};
+    for (int i = 0; i < threads; i++)
+    {
+        parts[i] = *scan;
+        parts[i].part = i;
+        parts[i].parts = threads;
+        parts[i].hits = i ? (IntVec){0} : *hits;
+        if (i > 0 && scan->heap.limit)
+            parts[i].heap.items = xrealloc(NULL, scan->heap.limit * sizeof(TopEntry));
+        if (i > 0)
+            started[i] = pthread_create(&tids[i], NULL, shardScanPart, &parts[i]) == 0;
+    }
+    shardScanPart(&parts[0]);
+    *hits = parts[0].hits;
+    scan->heap = parts[0].heap;
+    for (int i = 1; i < threads; i++)
+    {
+        if (started[i])
+            pthread_join(tids[i], NULL);
+        else
+            shardScanPart(&parts[i]);
+        for (int j = 0; j < parts[i].hits.count; j++)
+            intVecPush(hits, parts[i].hits.items[j]);
+        for (int j = 0; j < parts[i].heap.count; j++)
+            topPush(&scan->heap, parts[i].heap.items[j]);
+        free(parts[i].hits.items);
+        free(parts[i].heap.items);
+    }
+}
+
+// Put car slots in order with one bit per slot: a sweep of carTable.count
+// bits instead of a sort of the hits. Each thread keeps its own bitmap.
+void sortCarSlots(IntVec *slots)
+{
+    static __thread unsigned long long *bits = NULL;
+    static __thread int words = 0;
+    int need = (carTable.count + 63) / 64;
+    if (need > words)
+    {
+        bits = xrealloc(bits, need * sizeof(*bits));
+        memset(bits + words, 0, (need - words) * sizeof(*bits));
+        words = need;
+    }
+    for (int i = 0; i < slots->count; i++)
+        bits[slots->items[i] >> 6] |= 1ULL << (slots->items[i] & 63);
+    slots->count = 0;
+    for (int w = 0; w < need; w++)
+    {
+        for (unsigned long long b = bits[w]; b; b &= b - 1)
+            slots->items[slots->count++] = w * 64 + __builtin_ctzll(b);
+        bits[w] = 0;
+    }
+}
+
+// --------------------------- Top-K ---------------------------
+// The k best available cars by price, year or rentals. Cheapest and newest
+// over the whole fleet walk the price and year indexes from the right end
+// and stop after k available cars. The rest (most rented, or any kind at
+// one branch) scan the shard columns into a bounded heap of k entries:
+// O(n log k), with no sort of the n candidates.
+const char *topKindNames[] = {"cheapest", "newest", "rented"};
+
+// TOP_* for a name in topKindNames, -1 if there is none.
+int topKindFind(const char *name)
+{
+    for (int i = TOP_CHEAPEST; i <= TOP_MOST_RENTED; i++)
+        if (strcmp(name, topKindNames[i]) == 0)
+            return i;
+    return -1;
+}
+
+int topBetter(const TopEntry *a, const TopEntry *b)
+{
+    if (a->key != b->key)
+        return a->key > b->key;
+    return a->tie > b->tie;
+}
+
+void topPush(TopHeap *h, TopEntry e)
+{
+    if (h->count < h->limit)
+    {
+        int i = h->count++;
+        for (; i > 0 && topBetter(&h->items[(i - 1) / 2], &e); i = (i - 1) / 2)
+            h->items[i] = h->items[(i - 1) / 2];
+        h->items[i] = e;
+    }
+    else if (h->limit > 0 && topBetter(&e, &h->items[0]))
+        topSiftDown(h, e);
+}
+
+// Put e in place of the root and restore the heap order below it.
+void topSiftDown(TopHeap *h, TopEntry e)
+{
+    int i = 0;
+    for (;;)
+    {
+        int c = 2 * i + 1;
+        if (c >= h->count)
+            break;
+        if (c + 1 < h->count && topBetter(&h->items[c], &h->items[c + 1]))
+            c++;
+        if (!topBetter(&e, &h->items[c]))
+            break;
+        h->items[i] = h->items[c];
+        i = c;
+    }
+    h->items[i] = e;
+}
+
+// Empty the heap into slots, best first.
+void topSort(TopHeap *h, IntVec *slots)
+{
+    int n = h->count;
+    intVecResize(slots, n);
+    for (int i = n - 1; i >= 0; i--)
+    {
+        slots->items[i] = h->items[0].slot;
+        TopEntry last = h->items[--h->count];
+        if (h->count > 0)
+            topSiftDown(h, last);
+    }
+}
+
+// Ties go to the lower id, except for newest where the car added last
+// wins; this is the order the index walks produce.
+TopEntry topEntry(int kind, int slot)
+{
+    const Car *c = carAt(slot);
+    switch (kind)
+    {
+    case TOP_CHEAPEST:
+        return (TopEntry){slot, -c->pricePerDay, -c->id};
+    case TOP_NEWEST:
+        return (TopEntry){slot, c->year, c->id};
+    default:
+        return (TopEntry){slot, carStats(slot)->rentals, -c->id};
+    }
+}
+
+// Cheapest or newest over the whole fleet, from the indexes. The year
+// index can only be walked forward, so newest takes windows from its end,
+// each twice the last, and reads each window backwards. The caller holds
+// the read lock and indexLock.
+void topFromIndex(int kind, int k, IntVec *hits)
+{
+    if (kind == TOP_CHEAPEST)
+    {
+        for (SkipNode *n = skipSeek(&carsByPrice, 0); n && hits->count < k; n = n->next[0].node)
+            if (carAt(n->slot)->isAvailable)
+                intVecPush(hits, n->slot);
+        return;
+    }
+
+    int end = carsByYear.length;
+    for (int window = k; end > 0 && hits->count < k; window *= 2)
+    {
+        int start = end > window ? end - window : 0;
+        int first = hits->count;
+        SkipNode *n = skipSeek(&carsByYear, start);
+        for (int i = start; i < end; i++, n = n->next[0].node)
+            if (carAt(n->slot)->isAvailable)
+                intVecPush(hits, n->slot);
+        for (int i = first, j = hits->count - 1; i < j; i++, j--)
+        {
+            int t = hits->items[i];
+            hits->items[i] = hits->items[j];
+            hits->items[j] = t;
+        }
+        end = start;
+    }
+    if (hits->count > k)
+        hits->count = k;
+}
+
+// --------------------------- Name Search ---------------------------
+// Brands, models and customers are found by prefix ("toy" finds Toyota)
+// and with small typos, through a trie of each dictionary's names. A name
+// matches if some prefix of it is within maxTypos edits (Levenshtein) of
+// the query. The walk carries one row of the edit distance table per trie
+// level and leaves a branch as soon as no name below it can match or rank
+// among the first limit; shared prefixes are compared once. Names are
+// added to the trie as they are interned, so it is always current.
+void trieInsert(Dictionary *d, int id)
+{
+    if (d->trie.count == 0)
+        tableAppend(&d->trie); // the root
+    int node = 0;
+    for (const unsigned char *p = (const unsigned char *)dictName(d, id); *p; p++)
+    {
+        unsigned char c = tolower(*p);
+        int *link = &trieAt(d, node)->child;
+        while (*link && trieAt(d, *link)->c < c)
+            link = &trieAt(d, *link)->sibling;
+        if (!*link || trieAt(d, *link)->c != c)
+        {
+            int next = d->trie.count;
+            TrieNode *n = tableAppend(&d->trie);
+            n->c = c;
+            n->sibling = *link;
+            *link = next;
+        }
+        node = *link;
+    }
+
+    // Names that differ only in case share a node
+    intVecResize(&d->sameKey, d->names.count);
+    d->sameKey.items[id] = 0;
+    int *link = &trieAt(d, node)->name;
+    while (*link)
+        link = &d->sameKey.items[*link - 1];
+    *link = id + 1;
+}
+
+void trieRebuild(Dictionary *d)
+{
+    tableClear(&d->trie);
+    for (int i = 0; i < d->names.count; i++)
+        trieInsert(d, i);
+}
+
+// row is the edit distance table's row for this node's prefix; best is the
+// fewest typos of any prefix on the way here, which is what every name at
+// or below this node scores unless a longer prefix does better.
+void trieVisit(NameSearch *s, int node, const int *row, int best)
+{
+    if (best <= s->maxTypos)
+    {
+        for (int id = trieAt(s->dict, node)->name; id; id = s->dict->sameKey.items[id - 1])
+            if (s->found[best].count < s->limit)
+                intVecPush(&s->found[best], id - 1);
+    }
+
+    int next[CUSTOMER_NAME_LENGTH + 1];
+    for (int child = trieAt(s->dict, node)->child; child; child = trieAt(s->dict, child)->sibling)
+    {
+        unsigned char c = trieAt(s->dict, child)->c;
+        int low = next[0] = row[0] + 1;
+        for (int j = 1; j <= s->length; j++)
+        {
+            int cost = row[j - 1] + (s->query[j - 1] != c);
+            if (row[j] + 1 < cost)
+                cost = row[j] + 1;
+            if (next[j - 1] + 1 < cost)
+                cost = next[j - 1] + 1;
+            next[j] = cost;
+            if (cost < low)
+                low = cost;
+        }
+
+        // No name below can score better than this; skip the branch if that
+        // is too many typos or the first limit matches are already found.
+        int childBest = next[s->length] < best ? next[s->length] : best;
+        int floor = low < childBest ? low : childBest;
+        if (floor > s->maxTypos)
+            continue;
+        int ahead = 0;
+        for (int t = 0; t <= floor; t++)
+            ahead += s->found[t].count;
+        if (ahead < s->limit)
+            trieVisit(s, child, next, childBest);
+    }
+}
+
+// Fill ids with up to limit names matching query, fewest typos first and
+// alphabetically within that, and typos with their typo counts. Returns
+// the number of names found.
+int dictSearch(const Dictionary *d, const char *query, int limit, IntVec *ids, IntVec *typos)
+{
+    static __thread NameSearch s;
+    ids->count = typos->count = 0;
+    s.dict = d;
+    s.length = 0;
+    for (const char *p = query; *p && s.length < CUSTOMER_NAME_LENGTH - 1; p++)
+        s.query[s.length++] = tolower((unsigned char)*p);
+    s.maxTypos = s.length >= 2 * NAME_TYPO_LENGTH ? 2 : s.length >= NAME_TYPO_LENGTH ? 1 : 0;
+    s.limit = limit;
+    if (s.length == 0 || d->trie.count == 0)
+        return 0;
+
+    int row[CUSTOMER_NAME_LENGTH + 1];
+    for (int j = 0; j <= s.length; j++)
+        row[j] = j;
+    for (int t = 0; t <= s.maxTypos; t++)
+        s.found[t].count = 0;
+    trieVisit(&s, 0, row, s.length);
+    for (int t = 0; t <= s.maxTypos; t++)
+        for (int i = 0; i < s.found[t].count && ids->count < limit; i++)
+        {
+            intVecPush(ids, s.found[t].items[i]);
+            intVecPush(typos, t);
+        }
+    return ids->count;
+}
+
+// Append the cars with brand (isBrand) or model id to hits, from the
+// range of the brand or model index that holds them.
+void carsNamed(SkipList *index, int isBrand, int id, IntVec *hits)
+{
+    if (!index->head)
+        return;
+    Car probe = {0}; // id 0 sorts before every car with this name
+    if (isBrand)
+        probe.brand = id;
+    else
+        probe.model = id;
+    SkipNode *update[SKIP_MAX_LEVEL];
+    int rank[SKIP_MAX_LEVEL];
+    skipFind(index, &probe, update, rank);
+    for (SkipNode *n = update[0]->next[0].node; n; n = n->next[0].node)
+    {
+        const Car *c = carAt(n->slot);
+        if ((isBrand ? c->brand : c->model) != id)
+            break;
+        intVecPush(hits, n->slot);
+    }
+}
+
+// --------------------------- Reservations ---------------------------
+// Days are counted from 1970-01-01 in the proleptic Gregorian calendar.
+int dayFromDate(int year, int month, int day)
+{
+    year -= month <= 2;
+    int era = (year >= 0 ? year : year - 399) / 400;
+    int yoe = year - era * 400;
+    int doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+// Writes YYYY-MM-DD (or "-" for an unknown day, 0) into out[11].
+void formatDay(int day, char *out)
+{
+    if (day == 0)
+    {
+        strcpy(out, "-");
+        return;
+    }
+    int z = day + 719468;
+    int era = (z >= 0 ? z : z - 146096) / 146097;
+    int doe = z - era * 146097;
+    int yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    int doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    int mp = (5 * doy + 2) / 153;
+    int d = doy - (153 * mp + 2) / 5 + 1;
+    int m = mp < 10 ? mp + 3 : mp - 9;
+    int y = yoe + era * 400 + (m <= 2);
+    snprintf(out, 11, "%04u-%02u-%02u", (unsigned)y % 10000, (unsigned)m % 100, (unsigned)d % 100);
+}
+
+// Returns the day number of a YYYY-MM-DD date, or -1 if it is not one.
+// Parsed by hand: the text import reads two dates per rental.
+int parseDay(const char *s)
+{
+    static const char monthDays[] = {31, 29, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    static const int widths[] = {4, 2, 2};
+    int parts[3] = {0};
+    for (int i = 0; i < 3; i++)
+    {
+        int digits = 0;
+        for (; *s >= '0' && *s <= '9' && digits < widths[i]; s++, digits++)
+            parts[i] = parts[i] * 10 + (*s - '0');
+        if (!digits || *s != (i < 2 ? '-' : '\0'))
+            return -1;
+        s++;
+    }
+    int y = parts[0], m = parts[1], d = parts[2];
+    if (y < 1970 || m < 1 || m > 12 || d < 1 || d > monthDays[m - 1])
+        return -1;
+    if (m == 2 && d == 29 && (y % 4 != 0 || (y % 100 == 0 && y % 400 != 0)))
+        return -1;
+    return dayFromDate(y, m, d);
+}
+
+// The local date is only worked out again once the clock passes the next
+// midnight, so calling this per car in a scan is cheap.
+int today()
+{
+    static __thread time_t nextDay = 0;
+    static __thread int day;
+    time_t now = time(NULL);
+    if (now < nextDay)
+        return day;
+    struct tm tm;
+    localtime_r(&now, &tm);
+    day = dayFromDate(tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday);
+    tm.tm_hour = 24;
+    tm.tm_min = tm.tm_sec = 0;
+    tm.tm_isdst = -1;
+    nextDay = mktime(&tm);
+    return day;
+}
+
+BookingVec *carBookings(int slot)
+{
+    while (carBookingTable.count <= slot)
+        tableAppend(&carBookingTable);
+    return (BookingVec *)tableAt(&carBookingTable, slot);
+}
+
+// Index of the first booking that ends after day.
+int bookingSearch(const BookingVec *b, int day)
+{
+    int lo = 0, hi = b->count;
+    while (lo < hi)
+    {
+        int mid = (lo + hi) / 2;
+        if (b->items[mid].endDay <= day)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+// Does [startDay, endDay) overlap a booking's dates? Only the first booking
+// ending after startDay can.
+int bookingOverlap(const BookingVec *b, int startDay, int endDay)
+{
+    int i = bookingSearch(b, startDay);
+    return i < b->count && b->items[i].startDay < endDay;
+}
+
+// Can [startDay, endDay) not be booked? Besides overlapping a booking, a
+// rental still open after its end day (overdue; always the first booking)
+// keeps the car out until it is returned, so it blocks every new booking.
+int bookingConflict(const BookingVec *b, int startDay, int endDay)
+{
+    if (b->count > 0 && b->items[0].endDay <= startDay && b->items[0].endDay <= today())
+        return 1;
+    return bookingOverlap(b, startDay, endDay);
+}
+
+// Is the car out on day (today): has one of its open rentals started? That
+// includes an overdue one; the earliest booking is the one to look at.
+int bookingCovers(const BookingVec *b, int day)
+{
+    return b->count > 0 && b->items[0].startDay <= day;
+}
+
+// The caller has checked bookingConflict().
+void bookingAdd(BookingVec *b, int startDay, int endDay, int rentalSlot)
+{
+    if (b->count == b->cap)
+    {
+        b->cap = b->cap ? b->cap * 2 : 4;
+        b->items = xrealloc(b->items, b->cap * sizeof(Booking));
+    }
+    int i = bookingSearch(b, startDay);
+    memmove(&b->items[i + 1], &b->items[i], (b->count - i) * sizeof(Booking));
+    b->items[i] = (Booking){startDay, endDay, rentalSlot};
+    b->count++;
+}
+
+void bookingRemove(BookingVec *b, int rentalSlot)
+{
+    int i = bookingSearch(b, rentalAt(rentalSlot)->startDay);
+    if (i < b->count && b->items[i].rentalSlot == rentalSlot)
+    {
+        memmove(&b->items[i], &b->items[i + 1], (b->count - i - 1) * sizeof(Booking));
+        b->count--;
+    }
+}
+
+// Bookings are not persisted; they are rebuilt from the open rentals, which
+// also settles which cars are out today.
+void carBookingsRebuild()
 {
-    if (carCount == 0)
+    for (int i = 0; i < carBookingTable.count; i++)
+        ((BookingVec *)tableAt(&carBookingTable, i))->count = 0;
+    carBookings(carTable.count); // cover every slot up front
+
+    for (int i = 0; i < rentalTable.count; i++)
     {
-        printf("❌ No cars available!\n");
-        return;
+        const Rental *r = rentalAt(i);
+        int car = findCarIndex(r->carId);
+        if (r->isReturned || car == -1)
+            continue;
+        BookingVec *b = carBookings(car);
+        if (!bookingOverlap(b, r->startDay, r->endDay))
+            bookingAdd(b, r->startDay, r->endDay, i);
     }
 
-    char choice;
-    do
-    {
-        printf("\n----------------------------------------------------\n");
-        printf("List & Sort Cars\n");
-        printf("----------------------------------------------------\n");
-        printf("1. Sort by Car ID\n");
-        printf("2. Sort by Brand\n");
-        printf("3. Sort by Model\n");
-        printf("4. Sort by Year\n");
-        printf("5. Sort by Cost/Day\n");
-        printf("6. Sort by Status\n");
-        printf("7. Exit to Menu\n");
-        printf("\nEnter your choice: ");
-        scanf(" %c", &choice);
+    int now = today();
+    for (int i = 0; i < carTable.count; i++)
+        if (carAt(i)->id)
+            setCarAvailable(i, !bookingCovers(carBookings(i), now));
+    availabilityDay = now;
+}
 
-        switch (choice)
+// When the date changes while running, bookings starting today take their
+// cars out. Run before every read and change (from sharedSync() and
+// sharedBegin()); on any other call it is one compare.
+void availabilityRefresh()
+{
+    int now = today();
+    if (__atomic_load_n(&availabilityDay, __ATOMIC_ACQUIRE) == now)
+        return;
+    pthread_rwlock_rdlock(&storeLock);
+    pthread_mutex_lock(&indexLock);
+    if (availabilityDay != now)
+    {
+        for (int i = 0; i < carTable.count; i++)
         {
-        case '1': sortById(); break;
-        case '2': sortByBrand(); break;
-        case '3': sortByModel(); break;
-        case '4': sortByYear(); break;
-        case '5': sortByPrice(); break;
-        case '6': sortByStatus(); break;
-        case '7': continue;
-        default: printf("Invalid choice! Try again.\n"); continue;
+            if (!carAt(i)->id)
+                continue;
+            pthread_mutex_lock(carShardLock(i));
+            setCarAvailable(i, !bookingCovers(carBookings(i), now));
+            pthread_mutex_unlock(carShardLock(i));
         }
+        __atomic_store_n(&availabilityDay, now, __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&indexLock);
+    pthread_rwlock_unlock(&storeLock);
+}
 
-        printf("---------------------------------------------------------------------------------\n");
-        printf("%-8s %-15s %-15s %-10s %10s %15s\n", "Car ID", "Brand", "Model", "Year", "Cost/Day", "Status");
-        printf("---------------------------------------------------------------------------------\n");
-        for (int i = 0; i < carCount; i++)
-        {
-            printf("%-8d %-15s %-15s %-10d %10.02f %15s\n",
-                   cars[i].id, cars[i].brand, cars[i].model,
-                   cars[i].year, cars[i].pricePerDay,
-                   cars[i].isAvailable ? "Available" : "Rented");
-        }
-        printf("---------------------------------------------------------------------------------\n");
+// --------------------------- Aggregates ---------------------------
+// The totals are kept up to date as cars and rentals come and go, so the
+// report reads them directly instead of going through the rentals.
+// Revenue is counted when a rental is made, at the price billed then.
+RentalTotals *carStats(int slot)
+{
+    while (carStatsTable.count <= slot)
+        tableAppend(&carStatsTable);
+    return (RentalTotals *)tableAt(&carStatsTable, slot);
+}
 
-    } while (choice != '7');
+RentalTotals *customerStats(int user)
+{
+    while (customerStatsTable.count <= user)
+        tableAppend(&customerStatsTable);
+    return (RentalTotals *)tableAt(&customerStatsTable, user);
 }
 
+void statsCarAdded(int slot)
+{
+    carStats(slot); // create its entry while the write lock is held
+    brandAt(carAt(slot)->brand)->cars++;
+    branchAt(carAt(slot)->branch)->cars++;
+    fleetStats.cars++;
+    if (!carAt(slot)->isAvailable)
+        statsCarRented(slot, 1);
+}
 
-// --------------------------- Rentals ---------------------------
-void rentCar(const char *username)
+// A deleted car's slot is reused, so its totals go with it; its brand,
+// branch and the fleet keep the revenue it brought in.
+void statsCarRemoved(int slot)
 {
-    int id, days;
-    printf("Enter Car ID to Rent: ");
-    scanf("%d", &id);
-    while (getchar() != '\n')
-        ;
+    if (!carAt(slot)->isAvailable)
+        statsCarRented(slot, -1);
+    brandAt(carAt(slot)->brand)->cars--;
+    branchAt(carAt(slot)->branch)->cars--;
+    fleetStats.cars--;
+    *carStats(slot) = (RentalTotals){0};
+}
 
-    int found = -1;
-    for (int i = 0; i < carCount; i++)
-        if (cars[i].id == id && cars[i].isAvailable)
-        {
-            found = i;
-            break;
-        }
+void statsCarRented(int slot, int delta)
+{
+    brandAt(carAt(slot)->brand)->rented += delta;
+    branchAt(carAt(slot)->branch)->rented += delta;
+    fleetStats.rented += delta;
+}
 
-    if (found == -1)
+// Count a new rental; carSlot is -1 if its car no longer exists.
+void statsRentalAdded(int rentalSlot, int carSlot)
+{
+    const Rental *r = rentalAt(rentalSlot);
+    if (carSlot != -1)
     {
-        printf("❌ Car not available!\n");
-        return;
+        RentalTotals *c = carStats(carSlot);
+        c->revenue += r->totalCost;
+        c->rentals++;
+        BrandStats *b = brandAt(carAt(carSlot)->brand);
+        b->revenue += r->totalCost;
+        b->rentals++;
+        b = branchAt(carAt(carSlot)->branch);
+        b->revenue += r->totalCost;
+        b->rentals++;
     }
-
-    printf("Enter Number of Days: ");
-    scanf("%d", &days);
-    while (getchar() != '\n')
-        ;
-
-    cars[found].isAvailable = 0;
-
-    Rental r;
-    r.rentalId = rentalCount + 1;
-    strcpy(r.customerName, username);
-    r.carId = cars[found].id;
-    r.days = days;
-    r.totalCost = days * cars[found].pricePerDay;
-
-    rentals[rentalCount++] = r;
-
-    // ----- Print Bill -----
-    printf("\n========================================\n");
-    printf("            CAR RENTAL BILL             \n");
-    printf("========================================\n");
-    printf("Rental ID       : %d\n", r.rentalId);
-    printf("Customer Name   : %s\n", r.customerName);
-    printf("Car ID          : %d\n", r.carId);
-    printf("Car Brand       : %s\n", cars[found].brand);
-    printf("Car Model       : %s\n", cars[found].model);
-    printf("Rental Days     : %d\n", r.days);
-    printf("Price per Day   : ₹%.2f\n", cars[found].pricePerDay);
-    printf("----------------------------------------\n");
-    printf("Total Cost      : ₹%.2f\n", r.totalCost);
-    printf("Status          : %s\n", cars[found].isAvailable ? "Available" : "Rented");
-    printf("========================================\n\n");
+    int user = findUserIndex(rentalCustomer(r));
+    if (user != -1)
+    {
+        RentalTotals *u = customerStats(user);
+        u->revenue += r->totalCost;
+        u->rentals++;
+    }
+    fleetStats.revenue += r->totalCost;
+    fleetStats.rentals++;
 }
 
-void returnCar()
+// Take back what statsRentalAdded() counted for a booking cancelled before
+// its start. The rental is kept, returned and costing nothing, so totals
+// rebuilt later from the rentals leave it out too.
+void statsRentalCancelled(int rentalSlot, int carSlot)
 {
-    int rid;
-    printf("Enter Rental ID to Return: ");
-    scanf("%d", &rid);
-    while (getchar() != '\n')
-        ;
+    Rental *r = rentalAt(rentalSlot);
+    if (carSlot != -1)
+    {
+        RentalTotals *c = carStats(carSlot);
+        c->revenue -= r->totalCost;
+        c->rentals--;
+        BrandStats *b = brandAt(carAt(carSlot)->brand);
+        b->revenue -= r->totalCost;
+        b->rentals--;
+        b = branchAt(carAt(carSlot)->branch);
+        b->revenue -= r->totalCost;
+        b->rentals--;
+    }
+    int user = findUserIndex(rentalCustomer(r));
+    if (user != -1)
+    {
+        RentalTotals *u = customerStats(user);
+        u->revenue -= r->totalCost;
+        u->rentals--;
+    }
+    fleetStats.revenue -= r->totalCost;
+    fleetStats.rentals--;
+    r->totalCost = 0;
+}
 
-    int found = -1;
-    for (int i = 0; i < rentalCount; i++)
+// Imported text files have no totals; they are counted in one pass over
+// the rentals. Returns how many
+// rentals were counted.
+int statsRebuild()
+{
+    for (int i = 0; i < carStatsTable.count; i++)
+        *(RentalTotals *)tableAt(&carStatsTable, i) = (RentalTotals){0};
+    for (int i = 0; i < customerStatsTable.count; i++)
+        *(RentalTotals *)tableAt(&customerStatsTable, i) = (RentalTotals){0};
+    for (int i = 0; i < brandTable.count; i++)
     {
-        if (rentals[i].rentalId == rid)
-        {
-            found = i;
-            break;
-        }
+        brandAt(i)->revenue = 0;
+        brandAt(i)->rentals = 0;
     }
+    for (int i = 0; i < branchTable.count; i++)
+    {
+        branchAt(i)->revenue = 0;
+        branchAt(i)->rentals = 0;
+    }
+    fleetStats.revenue = 0;
+    fleetStats.rentals = 0;
 
-    if (found == -1)
+    int counted = 0;
+    for (int i = 0; i < rentalTable.count; i++)
     {
-        printf("❌ Rental not found!\n");
-        return;
+        if (rentalAt(i)->isReturned == 1 && rentalAt(i)->totalCost == 0)
+            continue; // cancelled before it started
+        statsRentalAdded(i, findCarIndex(rentalAt(i)->carId));
+        counted++;
     }
+    return counted;
+}
 
-    // Mark car available again
-    int carIndex = -1;
-    for (int i = 0; i < carCount; i++)
+// The car counts are derived from the fleet itself, so they are simply
+// recounted once the cars' status is settled at startup.
+void statsRecount()
+{
+    for (int i = 0; i < brandTable.count; i++)
     {
-        if (cars[i].id == rentals[found].carId)
-        {
-            cars[i].isAvailable = 1;
-            carIndex = i;
-            break;
-        }
+        brandAt(i)->cars = 0;
+        brandAt(i)->rented = 0;
+    }
+    for (int i = 0; i < branchTable.count; i++)
+    {
+        branchAt(i)->cars = 0;
+        branchAt(i)->rented = 0;
     }
+    fleetStats.cars = 0;
+    fleetStats.rented = 0;
+    for (int i = 0; i < carTable.count; i++)
+    {
+        if (!carAt(i)->id)
+            continue;
+        brandAt(carAt(i)->brand)->cars++;
+        branchAt(carAt(i)->branch)->cars++;
+        fleetStats.cars++;
+        if (!carAt(i)->isAvailable)
+            statsCarRented(i, 1);
+    }
+}
 
-    // Print return receipt
-    printf("\n========================================\n");
-    printf("         CAR RETURN RECEIPT             \n");
-    printf("========================================\n");
-    printf("Rental ID       : %d\n", rentals[found].rentalId);
-    printf("Customer Name   : %s\n", rentals[found].customerName);
-    printf("Car ID          : %d\n", rentals[found].carId);
-    if (carIndex != -1)
+// Insert id into top (sorted by key, highest first) if it ranks among the
+// first limit entries.
+void rankInsert(int *top, double *keys, int *count, int limit, int id, double key)
+{
+    int i = *count < limit ? (*count)++ : limit;
+    if (i == limit && key <= keys[limit - 1])
+        return;
+    if (i == limit)
+        i--;
+    for (; i > 0 && keys[i - 1] < key; i--)
     {
-        printf("Car Brand       : %s\n", cars[carIndex].brand);
-        printf("Car Model       : %s\n", cars[carIndex].model);
-        printf("Price per Day   : ₹%.2f\n", cars[carIndex].pricePerDay);
+        top[i] = top[i - 1];
+        keys[i] = keys[i - 1];
     }
-    printf("Rental Days     : %d\n", rentals[found].days);
-    printf("----------------------------------------\n");
-    printf("Total Cost      : ₹%.2f\n", rentals[found].totalCost);
-    printf("Status          : Returned ✅\n");
-    printf("========================================\n\n");
+    top[i] = id;
+    keys[i] = key;
+}
 
-    printf("✅ Car Returned Successfully!\n");
+double percent(int part, int whole)
+{
+    return whole > 0 ? 100.0 * part / whole : 0;
 }
 
-// --------------------------- Delete Car ---------------------------
-void deleteCar()
+void revenueReport()
 {
-    int id;
-    printf("Enter Car ID to Delete: ");
-    scanf("%d", &id);
-    while (getchar() != '\n')
-        ; // clear newline
+    OutBuf *out = &listBuf;
+    bufPrintf(out, "\n---------------------------------------------------------------------------------\n");
+    bufPrintf(out, "Revenue Report\n");
+    bufPrintf(out, "---------------------------------------------------------------------------------\n");
+    bufPrintf(out, "Total revenue   : ₹%.2f from %lld rentals\n", fleetStats.revenue, fleetStats.rentals);
+    bufPrintf(out, "Cars rented out : %d of %d (%.1f%% utilization)\n", fleetStats.rented, fleetStats.cars,
+              percent(fleetStats.rented, fleetStats.cars));
 
-    int found = -1;
-    for (int i = 0; i < carCount; i++)
+    // Brands, highest revenue first
+    int brands = 0;
+    int *order = xrealloc(NULL, (brandTable.count + 1) * sizeof(int));
+    double *keys = xrealloc(NULL, (brandTable.count + 1) * sizeof(double));
+    for (int i = 0; i < brandTable.count; i++)
+        if (brandAt(i)->cars > 0 || brandAt(i)->rentals > 0)
+            rankInsert(order, keys, &brands, brandTable.count, i, brandAt(i)->revenue);
+    bufPrintf(out, "\n%-15s %6s %8s %9s %15s %12s\n", "Brand", "Cars", "Rented", "Rentals", "Revenue", "Utilization");
+    bufPrintf(out, "---------------------------------------------------------------------------------\n");
+    for (int i = 0; i < brands; i++)
     {
-        if (cars[i].id == id)
-        {
-            found = i;
-            break;
-        }
+        const BrandStats *b = brandAt(order[i]);
+        bufPrintf(out, "%-15s %6d %8d %9d ₹%14.2f %11.1f%%\n", dictName(&brandDict, order[i]), b->cars, b->rented, b->rentals, b->revenue,
+                  percent(b->rented, b->cars));
     }
+    free(order);
+    free(keys);
 
-    if (found == -1)
+    // Branches, the same way
+    int branches = 0;
+    order = xrealloc(NULL, (branchTable.count + 1) * sizeof(int));
+    keys = xrealloc(NULL, (branchTable.count + 1) * sizeof(double));
+    for (int i = 0; i < branchTable.count; i++)
+        if (branchAt(i)->cars > 0 || branchAt(i)->rentals > 0)
+            rankInsert(order, keys, &branches, branchTable.count, i, branchAt(i)->revenue);
+    bufPrintf(out, "\n%-15s %6s %8s %9s %15s %12s\n", "Branch", "Cars", "Rented", "Rentals", "Revenue", "Utilization");
+    bufPrintf(out, "---------------------------------------------------------------------------------\n");
+    for (int i = 0; i < branches; i++)
     {
-        printf("❌ Car not found!\n");
-        return;
+        const BrandStats *b = branchAt(order[i]);
+        bufPrintf(out, "%-15s %6d %8d %9d ₹%14.2f %11.1f%%\n", dictName(&branchDict, order[i]), b->cars, b->rented, b->rentals, b->revenue,
+                  percent(b->rented, b->cars));
     }
+    free(order);
+    free(keys);
 
-    // Shift remaining cars left
-    for (int i = found; i < carCount - 1; i++)
+    int top[REPORT_TOP];
+    double topKeys[REPORT_TOP];
+    int count = 0;
+    for (int i = 0; i < carStatsTable.count && i < carTable.count; i++)
+        if (carAt(i)->id && carStats(i)->rentals > 0)
+            rankInsert(top, topKeys, &count, REPORT_TOP, i, carStats(i)->revenue);
+    bufPrintf(out, "\nTop %d cars by revenue\n", REPORT_TOP);
+    bufPrintf(out, "%-8s %-15s %-15s %9s %15s\n", "ID", "Brand", "Model", "Rentals", "Revenue");
+    bufPrintf(out, "---------------------------------------------------------------------------------\n");
+    for (int i = 0; i < count; i++)
     {
-        cars[i] = cars[i + 1];
+        const Car *c = carAt(top[i]);
+        bufPrintf(out, "%-8d %-15s %-15s %9d ₹%14.2f\n", c->id, carBrand(c), carModel(c), carStats(top[i])->rentals, topKeys[i]);
     }
 
-    carCount--;
-    printf("✅ Car Deleted!\n");
+    count = 0;
+    for (int i = 0; i < customerStatsTable.count; i++)
+        if (customerStats(i)->rentals > 0)
+            rankInsert(top, topKeys, &count, REPORT_TOP, i, customerStats(i)->revenue);
+    bufPrintf(out, "\nTop %d customers by spend\n", REPORT_TOP);
+    bufPrintf(out, "%-20s %9s %15s\n", "Username", "Rentals", "Spent");
+    bufPrintf(out, "---------------------------------------------------------------------------------\n");
+    for (int i = 0; i < count; i++)
+        bufPrintf(out, "%-20s %9d ₹%14.2f\n", userAt(top[i])->username, customerStats(top[i])->rentals, topKeys[i]);
+    bufPrintf(out, "---------------------------------------------------------------------------------\n");
+    bufFlush(out);
 }
 
-void listRentals()
+// --------------------------- Rental History ---------------------------
+// LEB128: 7 bits per byte, low bits first, high bit set on all but the last.
+int varintPut(unsigned char *p, unsigned int v)
 {
-    if (rentalCount == 0)
+    int n = 0;
+    for (; v >= 0x80; v >>= 7)
+        p[n++] = (unsigned char)(v | 0x80);
+    p[n++] = (unsigned char)v;
+    return n;
+}
+
+// Returns NULL if the number runs past end.
+const unsigned char *varintGet(const unsigned char *p, const unsigned char *end, unsigned int *v)
+{
+    *v = 0;
+    for (int shift = 0; p < end && shift < 35; shift += 7)
     {
-        printf("❌ No rentals yet!\n");
-        return;
+        unsigned char b = *p++;
+        *v |= (unsigned int)(b & 0x7f) << shift;
+        if (!(b & 0x80))
+            return p;
     }
-    printf("\n---------------------------------------------------------------------------------\n");
-    printf("Rental List\n");
-    printf("---------------------------------------------------------------------------------\n");
-    printf("%-10s %-30s %-10s %-10s %20s\n", "Rental ID", "User", "CarID", "Days", "Total Cost");
-    printf("---------------------------------------------------------------------------------\n");
+    return NULL;
+}
 
-    for (int i = 0; i < rentalCount; i++)
-        printf("%-10d %-30s %-10d %-10d ₹%20.2f\n", rentals[i].rentalId, rentals[i].customerName, rentals[i].carId, rentals[i].days, rentals[i].totalCost);
+// Signed differences are zigzag encoded so small ones stay small.
+static inline unsigned int zigzag(int v) { return ((unsigned int)v << 1) ^ (unsigned int)(v >> 31); }
+static inline int unzigzag(unsigned int v) { return (int)(v >> 1) ^ -(int)(v & 1); }
 
-    printf("---------------------------------------------------------------------------------\n");
+// Pack a closed rental relative to the one before it: ids and start days
+// grow slowly, so they are stored as differences; the name takes only its
+// own length and isReturned is implied. Returns the bytes written.
+int historyEncode(unsigned char *p, const Rental *r, const Rental *prev)
+{
+    int n = 0;
+    n += varintPut(p + n, zigzag(r->rentalId - prev->rentalId));
+    const char *name = rentalCustomer(r);
+    int len = strnlen(name, CUSTOMER_NAME_LENGTH - 1);
+    p[n++] = (unsigned char)len;
+    memcpy(p + n, name, len);
+    n += len;
+    n += varintPut(p + n, r->carId);
+    n += varintPut(p + n, r->days);
+    memcpy(p + n, &r->totalCost, sizeof(r->totalCost));
+    n += sizeof(r->totalCost);
+    n += varintPut(p + n, zigzag(r->startDay - prev->startDay));
+    n += varintPut(p + n, zigzag(r->endDay - r->startDay));
+    return n;
 }
 
-// --------------------------- File Handling ---------------------------
-void saveData()
+// Returns the first byte after the record, or NULL if it is damaged.
+const unsigned char *historyDecode(const unsigned char *p, const unsigned char *end, Rental *r, const Rental *prev)
 {
-    FILE *fp;
+    unsigned int v, carId, days, start, length;
+    memset(r, 0, sizeof(*r));
+    if (!(p = varintGet(p, end, &v)) || p >= end || *p >= CUSTOMER_NAME_LENGTH || end - p < 1 + *p)
+        return NULL;
+    r->rentalId = prev->rentalId + unzigzag(v);
+    char name[CUSTOMER_NAME_LENGTH];
+    int len = *p++;
+    memcpy(name, p, len);
+    name[len] = '\0';
+    r->customer = dictIntern(&customerDict, name);
+    p += len;
+    if (!(p = varintGet(p, end, &carId)) || !(p = varintGet(p, end, &days)) || end - p < (long)sizeof(r->totalCost))
+        return NULL;
+    memcpy(&r->totalCost, p, sizeof(r->totalCost));
+    p += sizeof(r->totalCost);
+    if (!(p = varintGet(p, end, &start)) || !(p = varintGet(p, end, &length)))
+        return NULL;
+    r->carId = carId;
+    r->days = days;
+    r->isReturned = 1;
+    r->startDay = prev->startDay + unzigzag(start);
+    r->endDay = r->startDay + unzigzag(length);
+    return p;
+}
 
-    // Users
-    fp = fopen("users.txt", "w");
-    if (fp)
-    {
-        fprintf(fp, "%d\n", user_count);
-        for (int i = 0; i < user_count; i++)
-            fprintf(fp, "%s,%s,%d\n", users[i].username, users[i].password, users[i].isAdmin);
-        fclose(fp);
-    }
+// Segments are written once, under a temporary name, and renamed into
+// place; they only count once a snapshot lists them.
+int historyWriteSegment(int segment, const Rental *rentals, int count)
+{
+    char path[64], tmp[72];
+    snprintf(path, sizeof(path), HISTORY_FILE_FORMAT, segment);
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
 
-    // Cars
-    fp = fopen("cars.txt", "w");
-    if (fp)
+    unsigned char *data = xrealloc(NULL, (size_t)count * HISTORY_RECORD_MAX);
+    Rental prev = {0};
+    HistoryHeader h = {HISTORY_MAGIC, count, 0};
+    for (int i = 0; i < count; i++)
     {
-        fprintf(fp, "%d\n", carCount);
-        for (int i = 0; i < carCount; i++)
-            fprintf(fp, "%d,%s,%s,%d,%.2f,%d\n", cars[i].id, cars[i].brand, cars[i].model, cars[i].year, cars[i].pricePerDay, cars[i].isAvailable);
-        fclose(fp);
+        h.size += historyEncode(data + h.size, &rentals[i], &prev);
+        prev = rentals[i];
     }
 
-    // Rentals
-    fp = fopen("rentals.txt", "w");
+    FILE *fp = fopen(tmp, "wb");
+    int ok = fp && fwrite(&h, sizeof(h), 1, fp) == 1 && fwrite(data, 1, h.size, fp) == (size_t)h.size;
+    ok = ok && fflush(fp) == 0 && fsync(fileno(fp)) == 0;
     if (fp)
+        ok = fclose(fp) == 0 && ok;
+    free(data);
+    if (!ok || rename(tmp, path) != 0)
     {
-        fprintf(fp, "%d\n", rentalCount);
-        for (int i = 0; i < rentalCount; i++)
-            fprintf(fp, "%d,%s,%d,%d,%.2f\n", rentals[i].rentalId, rentals[i].customerName, rentals[i].carId, rentals[i].days, rentals[i].totalCost);
-        fclose(fp);
+        printf("❌ Could not write %s!\n", path);
+        remove(tmp);
+        return -1;
     }
+    return 0;
 }
 
-void loadData()
+// Read and unpack a whole segment; the caller frees the result. Returns
+// NULL if the file is missing or damaged.
+Rental *historyReadSegment(int segment, int *count)
 {
-    FILE *fp;
+    char path[64];
+    snprintf(path, sizeof(path), HISTORY_FILE_FORMAT, segment);
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+    struct stat st;
+    HistoryHeader h;
+    int ok = fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(h);
+    unsigned char *base = ok ? mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (base == MAP_FAILED)
+        return NULL;
 
-    // Users
-    fp = fopen("users.txt", "r");
-    if (fp)
+    memcpy(&h, base, sizeof(h));
+    Rental *rentals = NULL;
+    if (h.magic == HISTORY_MAGIC && h.records >= 0 && h.records <= HISTORY_SEGMENT_RECORDS && h.size == st.st_size - (off_t)sizeof(h))
     {
-        fscanf(fp, "%d\n", &user_count);
-        for (int i = 0; i < user_count; i++)
-            fscanf(fp, " %[^,],%[^,],%d\n", users[i].username, users[i].password, &users[i].isAdmin);
-        fclose(fp);
+        rentals = xrealloc(NULL, (h.records + 1) * sizeof(Rental));
+        const unsigned char *p = base + sizeof(h), *end = p + h.size;
+        Rental prev = {0};
+        for (int i = 0; i < h.records && p; i++)
+        {
+            p = historyDecode(p, end, &rentals[i], &prev);
+            prev = rentals[i];
+        }
+        if (!p)
+        {
+            free(rentals);
+            rentals = NULL;
+        }
+        *count = h.records;
     }
-    else
-        user_count = 0;
+    munmap(base, st.st_size);
+    if (!rentals)
+        printf("❌ %s is damaged!\n", path);
+    return rentals;
+}
 
-    // Cars
-    fp = fopen("cars.txt", "r");
-    if (fp)
+// The index-th archived rental, oldest first; NULL if its segment cannot
+// be read. Segments are read on demand, one at a time.
+const Rental *historyAt(int index)
+{
+    int segment = 0;
+    while (segment < historyCounts.count && index >= historyCounts.items[segment])
+        index -= historyCounts.items[segment++];
+    if (segment == historyCounts.count)
+        return NULL;
+
+    if (segment != historyCacheSegment)
     {
-        fscanf(fp, "%d\n", &carCount);
-        for (int i = 0; i < carCount; i++)
-            fscanf(fp, " %d,%[^,],%[^,],%d,%f,%d\n", &cars[i].id, cars[i].brand, cars[i].model, &cars[i].year, &cars[i].pricePerDay, &cars[i].isAvailable);
-        fclose(fp);
+        int count = 0;
+        free(historyCache);
+        historyCache = historyReadSegment(segment, &count);
+        historyCacheSegment = historyCache && count == historyCounts.items[segment] ? segment : -1;
     }
-    else
-        carCount = 0;
+    return historyCacheSegment == segment ? &historyCache[index] : NULL;
+}
 
-    // Rentals
-    fp = fopen("rentals.txt", "r");
-    if (fp)
+// Collect the archived rentals of one customer, oldest first, into *found
+// (freed by the caller). Only the segments holding some of them are read.
+// Returns how many there are.
+int historyFind(const char *username, Rental **found)
+{
+    int total = 0;
+    *found = NULL;
+    int customer = dictFind(&customerDict, username);
+    if (customer == -1 || customer >= historyRefHead.count)
+        return 0;
+    for (int ref = historyRefHead.items[customer]; ref; ref = ((HistoryRef *)tableAt(&historyRefTable, ref - 1))->next)
+        total += ((HistoryRef *)tableAt(&historyRefTable, ref - 1))->count;
+    if (total == 0)
+        return 0;
+
+    // The chain runs newest first; fill the result from its end
+    *found = xrealloc(NULL, total * sizeof(Rental));
+    int count = total;
+    for (int ref = historyRefHead.items[customer]; ref; ref = ((HistoryRef *)tableAt(&historyRefTable, ref - 1))->next)
     {
-        fscanf(fp, "%d\n", &rentalCount);
-        for (int i = 0; i < rentalCount; i++)
-            fscanf(fp, " %d,%[^,],%d,%d,%f\n", &rentals[i].rentalId, rentals[i].customerName, &rentals[i].carId, &rentals[i].days, &rentals[i].totalCost);
-        fclose(fp);
+        const HistoryRef *h = tableAt(&historyRefTable, ref - 1);
+        int n = 0;
+        Rental *rentals = historyReadSegment(h->segment, &n);
+        for (int i = n - 1; rentals && i >= 0 && count > 0; i--)
+            if (rentals[i].customer == customer)
+                (*found)[--count] = rentals[i];
+        free(rentals);
     }
-    else
-        rentalCount = 0;
+
+    // Segments that could not be read leave a gap at the front
+    memmove(*found, *found + count, (total - count) * sizeof(Rental));
+    return total - count;
 }
 
-void sortById()
+// Note which customers have rentals in a segment just written.
+void historyRefAdd(int segment, const Rental *rentals, int count)
 {
-    for (int i = 0; i < carCount - 1; i++)
+    for (int i = 0; i < count; i++)
     {
-        for (int j = 0; j < carCount - i - 1; j++)
+        int customer = rentals[i].customer;
+        if (customer >= historyRefHead.count)
+            intVecResize(&historyRefHead, customer + 1);
+        int head = historyRefHead.items[customer];
+        HistoryRef *h = head ? tableAt(&historyRefTable, head - 1) : NULL;
+        if (h && h->segment == segment)
         {
-            if (cars[j].id > cars[j + 1].id)
-            {
-                Car temp = cars[j];
-                cars[j] = cars[j + 1];
-                cars[j + 1] = temp;
-            }
+            h->count++;
+            continue;
         }
+        h = tableAppend(&historyRefTable);
+        *h = (HistoryRef){.customer = customer, .segment = segment, .count = 1, .next = head};
+        historyRefHead.items[customer] = historyRefTable.count;
     }
 }
 
-void sortByBrand()
+// Find each customer's newest entry again after loading.
+void historyRefsRebuild()
 {
-    for (int i = 0; i < carCount - 1; i++)
+    intVecResize(&historyRefHead, 0);
+    intVecResize(&historyRefHead, customerDict.names.count);
+    for (int i = 0; i < historyRefTable.count; i++)
     {
-        for (int j = 0; j < carCount - i - 1; j++)
-        {
-            if (strcmp(cars[j].brand, cars[j + 1].brand) > 0)
-            {
-                Car temp = cars[j];
-                cars[j] = cars[j + 1];
-                cars[j + 1] = temp;
-            }
-        }
+        const HistoryRef *h = tableAt(&historyRefTable, i);
+        if (h->customer >= 0 && h->customer < historyRefHead.count)
+            historyRefHead.items[h->customer] = i + 1;
     }
 }
 
-void sortByModel()
+// Segments past the ones the snapshot lists were written by an archive
+// whose snapshot never made it to disk; their rentals are still in the
+// snapshot or journal, so the files are dropped.
+void historyPrune()
 {
-    for (int i = 0; i < carCount - 1; i++)
+    historyTotal = 0;
+    for (int i = 0; i < historyCounts.count; i++)
+        historyTotal += historyCounts.items[i];
+    free(historyCache);
+    historyCache = NULL;
+    historyCacheSegment = -1;
+
+    char path[64];
+    for (int segment = historyCounts.count;; segment++)
     {
-        for (int j = 0; j < carCount - i - 1; j++)
-        {
-            if (strcmp(cars[j].model, cars[j + 1].model) > 0)
-            {
-                Car temp = cars[j];
-                cars[j] = cars[j + 1];
-                cars[j + 1] = temp;
-            }
-        }
+        snprintf(path, sizeof(path), HISTORY_FILE_FORMAT, segment);
+        if (unlink(path) != 0)
+            break;
     }
 }
 
-void sortByYear()
+// Move returned rentals from rentalTable into new history segments, then
+// checkpoint so the snapshot lists them. Rental slots change, so this only
+// runs while nothing else uses the store: at startup and on the way out,
+// and only if no other instance is running (it just checkpoints then).
+// Returns how many rentals were archived.
+int archiveRentals()
 {
-    for (int i = 0; i < carCount - 1; i++)
+    if (!sharedAlone())
+    {
+        checkpoint();
+        return 0;
+    }
+
+    Rental *closed = NULL;
+    int count = 0, cap = 0;
+    for (int i = 0; i < rentalTable.count; i++)
     {
-        for (int j = 0; j < carCount - i - 1; j++)
+        if (!rentalAt(i)->isReturned)
+            continue;
+        if (count == cap)
         {
-            if (cars[j].year > cars[j + 1].year)
-            {
-                Car temp = cars[j];
-                cars[j] = cars[j + 1];
-                cars[j + 1] = temp;
-            }
+            cap = cap ? cap * 2 : 1024;
+            closed = xrealloc(closed, cap * sizeof(Rental));
         }
+        closed[count++] = *rentalAt(i);
     }
-}
 
-void sortByPrice()
-{
-    for (int i = 0; i < carCount - 1; i++)
+    int archived = 0;
+    while (archived < count)
+    {
+        int n = count - archived < HISTORY_SEGMENT_RECORDS ? count - archived : HISTORY_SEGMENT_RECORDS;
+        if (historyWriteSegment(historyCounts.count, closed + archived, n) != 0)
+            break;
+        historyRefAdd(historyCounts.count, closed + archived, n);
+        intVecPush(&historyCounts, n);
+        historyTotal += n;
+        archived += n;
+    }
+    free(closed);
+
+    if (archived > 0)
     {
-        for (int j = 0; j < carCount - i - 1; j++)
+        // Keep the open rentals, and any closed ones that did not fit
+        int kept = 0, skipped = 0;
+        for (int i = 0; i < rentalTable.count; i++)
         {
-            if (cars[j].pricePerDay > cars[j + 1].pricePerDay)
+            if (rentalAt(i)->isReturned && skipped < archived)
             {
-                Car temp = cars[j];
-                cars[j] = cars[j + 1];
-                cars[j + 1] = temp;
+                skipped++;
+                continue;
             }
+            *rentalAt(kept++) = *rentalAt(i);
         }
+        rentalTable.count = kept;
+
+        intVecResize(&rentalSlotById, 0);
+        for (int i = 0; i < rentalTable.count; i++)
+            idMapSet(&rentalSlotById, rentalAt(i)->rentalId, i);
+        customerRentalsRebuild();
+        carBookingsRebuild();
+    }
+    checkpoint();
+    return archived;
+}
+
+// --------------------------- Metrics ---------------------------
+long long nowNanos()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+int metricBucket(unsigned long long ns)
+{
+    if (ns < (1u << METRIC_SUB_BITS))
+        return ns;
+    int top = 63 - __builtin_clzll(ns);
+    int sub = (ns >> (top - METRIC_SUB_BITS)) & ((1u << METRIC_SUB_BITS) - 1);
+    return ((top - METRIC_SUB_BITS + 1) << METRIC_SUB_BITS) | sub;
+}
+
+// The middle of the range of values that land in bucket.
+unsigned long long metricBucketValue(int bucket)
+{
+    if (bucket < (1 << METRIC_SUB_BITS))
+        return bucket;
+    int top = (bucket >> METRIC_SUB_BITS) + METRIC_SUB_BITS - 1;
+    unsigned long long width = 1ULL << (top - METRIC_SUB_BITS);
+    unsigned long long low = ((1ULL << METRIC_SUB_BITS) | (bucket & ((1 << METRIC_SUB_BITS) - 1))) * width;
+    return low + width / 2;
+}
+
+void metricRecord(int metric, long long start, int ok)
+{
+    Metric *m = &metrics[metric];
+    unsigned long long ns = nowNanos() - start;
+    __atomic_fetch_add(ok ? &m->ok : &m->failed, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&m->totalNs, ns, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&m->buckets[metricBucket(ns)], 1, __ATOMIC_RELAXED);
+    unsigned long long max = __atomic_load_n(&m->maxNs, __ATOMIC_RELAXED);
+    while (ns > max && !__atomic_compare_exchange_n(&m->maxNs, &max, ns, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
+}
+
+// For operations that return -1 on failure: record and pass result on.
+int metricResult(int metric, long long start, int result)
+{
+    metricRecord(metric, start, result != -1);
+    return result;
+}
+
+// The latency below which fraction of the recorded calls fall (never more
+// than the largest one seen).
+unsigned long long metricPercentile(const Metric *m, double fraction)
+{
+    unsigned long long count = 0, seen = 0;
+    for (int i = 0; i < METRIC_BUCKETS; i++)
+        count += m->buckets[i];
+    unsigned long long rank = (unsigned long long)(fraction * count);
+    for (int i = 0; i < METRIC_BUCKETS; i++)
+    {
+        seen += m->buckets[i];
+        if (seen > rank)
+            return metricBucketValue(i) < m->maxNs ? metricBucketValue(i) : m->maxNs;
     }
+    return m->maxNs;
 }
 
-void sortByStatus()
+// Latencies are shown in microseconds; table sizes are read under the
+// store's read lock.
+void statsFormat(OutBuf *out)
 {
-    for (int i = 0; i < carCount - 1; i++)
+    time_t now = time(NULL);
+    struct tm tm;
+    localtime_r(&now, &tm);
+    char stamp[32];
+    strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", &tm);
+
+    bufPrintf(out, "\n---------------------------------------------------------------------------------\n");
+    bufPrintf(out, "Statistics (%s)\n", stamp);
+    bufPrintf(out, "---------------------------------------------------------------------------------\n");
+    bufPrintf(out, "%-13s %8s %7s %9s %9s %9s %9s %9s %9s\n", "Operation", "OK", "Failed", "Mean us", "p50", "p90", "p99", "p99.9", "Max");
+    bufPrintf(out, "---------------------------------------------------------------------------------\n");
+    for (int i = 0; i < METRIC_COUNT; i++)
     {
-        for (int j = 0; j < carCount - i - 1; j++)
-        {
-            if (cars[j].isAvailable < cars[j + 1].isAvailable) // Available first
-            {
-                Car temp = cars[j];
-                cars[j] = cars[j + 1];
-                cars[j + 1] = temp;
-            }
-        }
+        const Metric *m = &metrics[i];
+        unsigned long long calls = m->ok + m->failed;
+        if (calls == 0)
+            continue;
+        bufPrintf(out, "%-13s %8llu %7llu %9.1f %9.1f %9.1f %9.1f %9.1f %9.1f\n", metricNames[i], m->ok, m->failed,
+                  m->totalNs / 1e3 / calls, metricPercentile(m, 0.5) / 1e3, metricPercentile(m, 0.9) / 1e3,
+                  metricPercentile(m, 0.99) / 1e3, metricPercentile(m, 0.999) / 1e3, m->maxNs / 1e3);
+    }
+
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    pthread_rwlock_rdlock(&storeLock);
+    bufPrintf(out, "---------------------------------------------------------------------------------\n");
+    bufPrintf(out, "Users %d, cars %d (%d free slots), brands %d\n", userTable.count, liveCarCount(), freeCarSlots.count, brandTable.count);
+    bufPrintf(out, "Open rentals %d, archived rentals %d in %d segments\n", rentalTable.count, historyTotal, historyCounts.count);
+    bufPrintf(out, "Journal: %d changes since the last checkpoint; mapped snapshot %zu bytes; peak RSS %ld KB\n",
+              journalOps, snapshotSize, ru.ru_maxrss);
+    bufPrintf(out, "---------------------------------------------------------------------------------\n");
+    pthread_rwlock_unlock(&storeLock);
+}
+
+void statsScreen()
+{
+    statsFormat(&listBuf);
+    bufFlush(&listBuf);
+}
+
+// Replace STATS_FILE with the current figures.
+void statsWrite()
+{
+    OutBuf out = {0};
+    statsFormat(&out);
+    FILE *fp = fopen(STATS_TMP_FILE, "w");
+    int ok = fp && fwrite(out.data, 1, out.len, fp) == out.len;
+    if (fp)
+        ok = fclose(fp) == 0 && ok;
+    if (!ok || rename(STATS_TMP_FILE, STATS_FILE) != 0)
+        remove(STATS_TMP_FILE);
+    free(out.data);
+}
+
+void *statsWriter(void *arg)
+{
+    (void)arg;
+    for (;;)
+    {
+        sleep(STATS_INTERVAL);
+        statsWrite();
     }
+    return NULL;
 }